@@ -44,20 +44,29 @@
 // rapidjson errors handling
 
 #include <rapidjson/document.h>
-#include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
 #include <cxxopts.hpp>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include "data_output.h"
+#include "data_source.h"
 #include "fitsdk/fit_convert.h"
+#include "overlay_template.h"
 #include "parser.h"
 
 constexpr const char kBanner[] = R"%(
@@ -78,52 +87,192 @@ constexpr const char kBanner[] = R"%(
 
 constexpr const char kHelp[] = R"%(
 
-usage: fitconvert -i input_file -o output_file -t output_type -f offset -s N
-
--i - path to .fit file to read data from
--o - path to .srt or .json file to write to
--t - export type: srt, vtt or json
+usage: fitconvert -i input_file -o output_file -t output_type -f offset -s N -j N [--fields list] [--index]
+                  [--from ms] [--to ms | --duration ms] [--follow[=seconds]]
+                  [--cache dir] [--template text]
+       fitconvert -i input_file_or_dir [-i ...] -d output_dir -j N -t output_type -f offset -s N
+       fitconvert -i input_file_or_dir [-i ...] --verify
+
+-i - path to .fit file to read data from (batch mode: .fit files or directories with .fit files, repeatable)
+-o - path to .srt or .json file to write to, '-' to write to stdout
+-d - batch mode: directory to write converted files to, output names are input names with the output type extension,
+    repeated names get a -2, -3... suffix
+-j - number of worker threads (optional, 0 for the number of CPU cores), batch mode: files converted in parallel,
+    default to the number of CPU cores, single file: threads to decode a large .fit file with, default to one
+--verify - only check header and file CRCs of the input files (-i), nothing is converted
+-t - export type: srt, vtt, json, json-columnar (the header and an array of values per data type, null for gaps)
+    or ndjson (a record per line, the header is the last line)
 -f - offset in milliseconds to sync video and .fit data (optional, for srt export only)
 * if the offset is positive - 'offset' second of the data from .fit file will be displayed at the first second of the video.
     it is for situations when you started video after starting recording your activity(that generated .fit file)
 * if the offset is negative - the first second of .fit data will be displayed at abs('offset') second of the video
     it is for situations when you started your activity (that generated .fit file) after starting the video
 -s - smooth values by inserting N smoothed values between timestamps (optional, for srt export only)
+--fields - comma separated list of data to decode, other fields are skipped (optional, default to all), values:
+    speed, distance, heartrate, altitude, power, cadence, temperature, latitude, longitude,
+    developer (developer fields of records, json export only, names that repeat others get a _2, _3... suffix)
+--index - write a seek index next to the input file (input.fit.idx) to convert time ranges of it faster later
+--from - start of the time range to convert, in milliseconds from the first record of the file (optional)
+--to - end of the time range to convert, in milliseconds from the first record of the file (optional)
+--duration - length of the time range to convert in milliseconds, instead of --to (optional)
+--follow - convert a .fit file that is still being written, cues are written as records are appended to it,
+    stops at the end of the file or when it did not grow for 'seconds' (optional, default to wait for the end)
+--cache - directory to keep parsed data in, files with the same content are not decoded again (optional)
+--template - layout of the subtitle text (optional, for srt export only): fields in braces with optional alignment
+    and width, sections in brackets are shown only when all their fields have values, \n is a new line, fields:
+    distance, speed, heartrate, cadence, power, temperature, altitude, ascent, descent, default layout:
+    [{distance:>5} km][{heartrate:>5} bpm][{cadence:>5} rpm][{power:>6} w][{ascent:>5} m][{speed:>6} km/h]
+    [{temperature:>4} C]
 )%";
 
 constexpr std::string_view kOutputJsonTag = "json";
+constexpr std::string_view kOutputJsonColumnarTag = "json-columnar";
+constexpr std::string_view kOutputNdjsonTag = "ndjson";
 constexpr std::string_view kOutputSrtTag = "srt";
 constexpr std::string_view kOutputVttTag = "vtt";
 constexpr std::string_view kVttHeaderTag("WEBVTT\n\n");
-
-struct Time {
-  int64_t hours{0};
-  int64_t minutes{0};
-  int64_t seconds{0};
-  int64_t milliseconds{0};
+constexpr std::string_view kFitExtensionTag(".fit");
+constexpr std::string_view kDeveloperFieldsTag("developer");
+constexpr const char kLogPattern[] = "[%H:%M:%S.%e] %^[%l]%$ %v";
+
+struct ConvertOptions {
+  std::string output_type;
+  int64_t offset{0};
+  uint8_t smoothness{0};
+  ParseOptions parse;
+  // compiled once and shared by the batch threads
+  std::shared_ptr<const OverlayTemplate> overlay;
 };
 
-struct SrtItem {
-  SrtItem(int64_t frame, int64_t milliseconds_from, int64_t milliseconds_to, std::string data)
-      : frame(frame), milliseconds_from(milliseconds_from), milliseconds_to(milliseconds_to), data(std::move(data)) {}
-  int64_t frame{0};
-  int64_t milliseconds_from{0};
-  int64_t milliseconds_to{0};
-  std::string data;
+struct ConvertStatus {
+  bool success{false};
+  size_t records{0};
 };
 
-Time GetTime(const int64_t milliseconds_total) {
-  Time time_struct;
-  int64_t ms_remainder = milliseconds_total;
-  time_struct.hours = ms_remainder / 3600000;
-  ms_remainder = ms_remainder - (time_struct.hours * 3600000);
-  time_struct.minutes = ms_remainder / 60000;
-  ms_remainder = ms_remainder - (time_struct.minutes * 60000);
-  time_struct.seconds = ms_remainder / 1000;
-  time_struct.milliseconds = ms_remainder - (time_struct.seconds * 1000);
-  return time_struct;
+// "00" to "99", two digits of the time parts are copied at once instead of dividing for every digit
+constexpr char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+char* WriteDigitPair(char* output, const int64_t value) {
+  std::memcpy(output, &kDigitPairs[value * 2], 2);
+  return output + 2;
 }
 
+// HH:MM:SS,mmm, at most 64 characters
+char* WriteCueTime(char* output, const int64_t milliseconds_total, const char milliseconds_delimiter) {
+  const int64_t hours = milliseconds_total / 3600000;
+  const int64_t minutes = milliseconds_total / 60000 % 60;
+  const int64_t seconds = milliseconds_total / 1000 % 60;
+  const int64_t milliseconds = milliseconds_total % 1000;
+  if (milliseconds_total < 0 || hours > 99) {
+    // out of the table
+    return fmt::format_to(
+        output, "{:0>2d}:{:0>2d}:{:0>2d}{}{:0>3d}", hours, minutes, seconds, milliseconds_delimiter, milliseconds);
+  }
+  output = WriteDigitPair(output, hours);
+  *output++ = ':';
+  output = WriteDigitPair(output, minutes);
+  *output++ = ':';
+  output = WriteDigitPair(output, seconds);
+  *output++ = milliseconds_delimiter;
+  *output++ = static_cast<char>('0' + milliseconds / 100);
+  return WriteDigitPair(output, milliseconds % 100);
+}
+
+// cues are written as soon as they are complete, the end of a cue is the start of the next one,
+// so only the last cue is held back and the memory does not depend on the records count
+// the text of the cues is formatted into buffers that are reused, so there are no allocations per cue
+class SubtitleWriter final {
+ public:
+  // live cues are flushed one by one, so a followed file shows up in the output as it grows
+  SubtitleWriter(const std::string& output_file, const bool vtt, const bool flush_cues)
+      : output_(DataOutput::Create(output_file)), flush_cues_(flush_cues) {
+    // differentiate between .srt and .vtt
+    if (vtt) {
+      milliseconds_delimiter_ = '.';
+      output_->Write(kVttHeaderTag);
+    }
+  }
+
+  // text of the next cue, it is formatted here before Add()
+  std::string& Text() { return text_; }
+
+  // adds the cue with the text formatted into Text()
+  void Add(const int64_t milliseconds_from, const int64_t milliseconds_to) {
+    if (has_pending_) {
+      Write(milliseconds_from);
+    }
+    // the buffers are swapped to keep the capacity of both
+    pending_text_.swap(text_);
+    text_.clear();
+    pending_from_ = milliseconds_from;
+    pending_to_ = milliseconds_to;
+    has_pending_ = true;
+  }
+
+  void Add(const int64_t milliseconds_from, const int64_t milliseconds_to, const std::string_view text) {
+    text_.assign(text);
+    Add(milliseconds_from, milliseconds_to);
+  }
+
+  void Finish() {
+    if (has_pending_) {
+      Write(pending_to_);
+      has_pending_ = false;
+    }
+    output_->Close();
+  }
+
+ private:
+  // the pending cue ends at milliseconds_to
+  void Write(const int64_t milliseconds_to) {
+    const fmt::format_int frame(frame_++);
+    output_->Write(frame.data(), frame.size());
+
+    char timing[160];
+    char* timing_end = timing;
+    *timing_end++ = '\n';
+    timing_end = WriteCueTime(timing_end, pending_from_, milliseconds_delimiter_);
+    std::memcpy(timing_end, " --> ", 5);
+    timing_end = WriteCueTime(timing_end + 5, milliseconds_to, milliseconds_delimiter_);
+    *timing_end++ = '\n';
+    output_->Write(timing, timing_end - timing);
+
+    output_->Write(pending_text_);
+    output_->Write("\n\n", 2);
+    if (flush_cues_) {
+      output_->Flush();
+    }
+  }
+
+  std::unique_ptr<DataOutput> output_;
+  char milliseconds_delimiter_{','};
+  std::string text_;
+  std::string pending_text_;
+  int64_t pending_from_{0};
+  int64_t pending_to_{0};
+  bool has_pending_{false};
+  int64_t frame_{0};
+  bool flush_cues_{false};
+};
+
+// rapidjson output stream over the buffered output, the text is written in large blocks as it is generated
+class JsonOutputStream final {
+ public:
+  using Ch = char;
+
+  explicit JsonOutputStream(DataOutput& output) : output_(output) {}
+
+  void Put(const Ch symbol) { output_.Put(symbol); }
+  // the writer flushes at the end of the document, the output is flushed by Close()
+  void Flush() {}
+
+ private:
+  DataOutput& output_;
+};
+
 struct ValueByType {
   bool Valid() const { return dt != DataType::kTypeMax; };
   int64_t value{0};
@@ -140,139 +289,253 @@ ValueByType GetValueByType(const Record& record, const DataType type) {
   return result;
 }
 
-std::string NumberToStringPrecision(const int64_t number,
-                                    const double divider,
-                                    const size_t total_symbols,
-                                    const size_t dot_limit) {
-  const double double_number = static_cast<double>(number);
-  std::string str_result(std::to_string(double_number / divider));
-  str_result = str_result.substr(0, total_symbols);
-  const size_t dot_string_size = str_result.size();
-  const size_t dot_position = str_result.find('.');
-  if (dot_position != std::string::npos) {
-    const size_t after_dot_position = dot_limit + 1;
-    if ((dot_string_size - dot_position) > after_dot_position) {
-      str_result = str_result.substr(0, (dot_position + after_dot_position));
-    }
+using JsonWriter = rapidjson::Writer<JsonOutputStream>;
+
+// the header array: data types that have values and developer channels with the conversion of their raw values
+void WriteJsonHeader(JsonWriter& writer, const FitResult& fit_result) {
+  writer.StartArray();
+  for (const auto& header_item : fit_result.header) {
+    writer.StartObject();
+    writer.Key("data");
+    writer.String(header_item.data_tag.data(), static_cast<rapidjson::SizeType>(header_item.data_tag.size()));
+    writer.Key("units");
+    writer.String(header_item.data_units.data(), static_cast<rapidjson::SizeType>(header_item.data_units.size()));
+    writer.EndObject();
   }
-
-  const size_t string_size = str_result.size();
-  if (string_size > 0 && str_result.at(string_size - 1) == '.') {
-    str_result = str_result.substr(0, string_size - 1);
+  for (const auto& channel : fit_result.developer_channels) {
+    writer.StartObject();
+    writer.Key("data");
+    writer.String(channel.name.data(), static_cast<rapidjson::SizeType>(channel.name.size()));
+    writer.Key("units");
+    writer.String(channel.units.data(), static_cast<rapidjson::SizeType>(channel.units.size()));
+    writer.Key("scale");
+    writer.Double(channel.scale);
+    writer.Key("offset");
+    writer.Double(channel.offset);
+    writer.EndObject();
   }
-  return str_result;
+  writer.EndArray();
 }
 
-int main(int argc, char* argv[]) {
-  spdlog::set_pattern("[%H:%M:%S.%e] %^[%l]%$ %v");
-
-  cxxopts::Options cmd_options("FIT converter", "FIT telemetry converter to SRT or JSON");
-  cmd_options.add_options()                                                               //
-      ("i,input", "", cxxopts::value<std::string>())                                      //
-      ("o,output", "", cxxopts::value<std::string>())                                     //
-      ("h,help", "")                                                                      //
-      ("t,type", "", cxxopts::value<std::string>()->default_value(kOutputSrtTag.data()))  //
-      ("f,offset", "", cxxopts::value<int64_t>()->default_value("0"))                     //
-      ("s,smooth", "", cxxopts::value<uint8_t>()->default_value("0"));                    //
-  const auto cmd_result = cmd_options.parse(argc, argv);
-
-  if (argc < 4 || cmd_result.count("help") > 0) {
-    std::cout << kBanner << std::endl;
-    std::cout << kHelp << std::endl;
-    return 1;
-  }
-
-  const std::string input_fit_file(cmd_result["input"].as<std::string>());
-  const std::string output_file(cmd_result["output"].as<std::string>());
-  const std::string output_type(cmd_result["type"].as<std::string>());
-  const int64_t offset = cmd_result["offset"].as<int64_t>();
-  const uint8_t smoothness = cmd_result["smooth"].as<uint8_t>();
-
-  try {
-    if (output_type != kOutputJsonTag && output_type != kOutputSrtTag && output_type != kOutputVttTag) {
-      SPDLOG_ERROR("unknown output specified: '{}', only srt, vtt and .json supported", output_type);
-      return 1;
+// the record object with the values it has, developer values are named by their channels
+void WriteJsonRecord(JsonWriter& writer, const Record& record, const std::vector<std::string>& developer_names) {
+  writer.StartObject();
+  for (uint32_t index = kDataTypeFirst; index < kDataTypeMax; ++index) {
+    const auto value_by_type = GetValueByType(record, static_cast<DataType>(index));
+    if (value_by_type.Valid()) {
+      const auto name = DataTypeToName(value_by_type.dt);
+      writer.Key(name.data(), static_cast<rapidjson::SizeType>(name.size()));
+      writer.Int64(value_by_type.value);
     }
-
-    if (output_type == kOutputJsonTag && (offset != 0 || smoothness != 0)) {
-      SPDLOG_WARN("smoothness or offset valid only for .srt output format");
+  }
+  for (uint32_t channel = 0; channel < developer_names.size(); ++channel) {
+    if ((record.developer_valid & (0x01 << channel)) != 0) {
+      const auto& name = developer_names[channel];
+      writer.Key(name.data(), static_cast<rapidjson::SizeType>(name.size()));
+      writer.Int64(record.developer_values[channel]);
     }
+  }
+  writer.EndObject();
+}
 
-    if (smoothness > 9) {
-      SPDLOG_ERROR("smoothness can not be more than 9");
-      return 1;
-    }
+// output files of the batch mode
+std::string_view GetOutputExtension(const std::string& output_type) {
+  if (kOutputJsonColumnarTag == output_type) {
+    return kOutputJsonTag;
+  }
+  return output_type;
+}
 
-    std::unique_ptr<FitResult> fit_result = FitParser(input_fit_file);
-    if (fit_result->status != ParseResult::kSuccess) {
-      // error reported in parser
-      return 1;
-    }
+ConvertStatus ConvertFile(const std::string& input_fit_file,
+                          const std::string& output_file,
+                          const ConvertOptions& options) {
+  ConvertStatus status;
+  try {
+    if (kOutputJsonTag == options.output_type && (kStdinTag == input_fit_file || options.parse.follow)) {
+      // the header goes first and is known only after the last record, a source that can be read once is collected
+      std::unique_ptr<FitResult> fit_result = FitParser(input_fit_file, options.parse);
+      if (fit_result->status != ParseResult::kSuccess) {
+        // error reported in parser
+        return status;
+      }
+      const RecordColumns& records = fit_result->result;
+      status.records = records.Size();
 
-    if (output_type == kOutputJsonTag) {
-      rapidjson::StringBuffer string_buffer;
-      rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
+      std::vector<std::string> developer_names;
+      for (const auto& channel : fit_result->developer_channels) {
+        developer_names.push_back(channel.name);
+      }
+      std::unique_ptr<DataOutput> output = DataOutput::Create(output_file);
+      JsonOutputStream output_stream(*output);
+      JsonWriter writer(output_stream);
       writer.StartObject();
-      // header
       writer.Key("header");
+      WriteJsonHeader(writer, *fit_result);
+      writer.Key("records");
       writer.StartArray();
-      // header objects
-      for (const auto& header_item : fit_result->header) {
-        writer.StartObject();
-        writer.Key("data");
-        writer.String(header_item.data_tag.data(), static_cast<rapidjson::SizeType>(header_item.data_tag.size()));
-        writer.Key("units");
-        writer.String(header_item.data_units.data(), static_cast<rapidjson::SizeType>(header_item.data_units.size()));
-        writer.EndObject();
+      for (size_t record_index = 0; record_index < records.Size(); ++record_index) {
+        WriteJsonRecord(writer, records.GetRecord(record_index), developer_names);
       }
       writer.EndArray();
-      // records
-      writer.Key("records");
-      writer.StartArray();
+      writer.EndObject();
+      output->Close();
+
+    } else if (kOutputJsonTag == options.output_type || kOutputNdjsonTag == options.output_type) {
+      // records are written as they are decoded, so the memory does not depend on the records count
+      // the header is known only after the last record: the json header goes first, so the file is decoded for it
+      // before the records, the ndjson header is the last line
+      const bool ndjson = kOutputNdjsonTag == options.output_type;
+      std::unique_ptr<FitResult> header_result;
+      if (false == ndjson) {
+        header_result = FitParser(input_fit_file, [](const Record&) { return true; }, options.parse);
+        if (header_result->status != ParseResult::kSuccess) {
+          // error reported in parser
+          return status;
+        }
+      }
 
-      for (const auto& item : fit_result->result) {
+      std::unique_ptr<DataOutput> output = DataOutput::Create(output_file);
+      JsonOutputStream output_stream(*output);
+      JsonWriter writer(output_stream);
+      if (false == ndjson) {
         writer.StartObject();
+        writer.Key("header");
+        WriteJsonHeader(writer, *header_result);
+        writer.Key("records");
+        writer.StartArray();
+      }
 
-        for (uint32_t index = kDataTypeFirst; index < kDataTypeMax; ++index) {
-          const auto value_by_type = GetValueByType(item, static_cast<DataType>(index));
-          if (value_by_type.Valid()) {
-            const auto name = DataTypeToName(value_by_type.dt);
-            writer.Key(name.data(), static_cast<rapidjson::SizeType>(name.size()));
-            writer.Int64(value_by_type.value);
+      // names of the developer channels are described before their values
+      std::vector<std::string> developer_names;
+      ParseOptions parse_options(options.parse);
+      parse_options.developer_channel_callback = [&developer_names](const uint32_t channel,
+                                                                    const DeveloperChannel& developer_channel) {
+        if (channel >= developer_names.size()) {
+          developer_names.resize(channel + 1);
+        }
+        developer_names[channel] = developer_channel.name;
+      };
+
+      const auto write_record = [&](const Record& record) {
+        if (ndjson) {
+          // every line is a document
+          writer.Reset(output_stream);
+        }
+        WriteJsonRecord(writer, record, developer_names);
+        if (ndjson) {
+          output->Put('\n');
+          // lines of a followed file are passed on as they are appended
+          if (options.parse.follow) {
+            output->Flush();
           }
         }
+        ++status.records;
+        return true;
+      };
+
+      std::unique_ptr<FitResult> fit_result = FitParser(input_fit_file, write_record, parse_options);
+      if (fit_result->status != ParseResult::kSuccess) {
+        // error reported in parser, the incomplete output is not left behind
+        output->Close();
+        if (kStdoutTag != output_file) {
+          std::filesystem::remove(output_file);
+        }
+        return status;
+      }
 
+      if (ndjson) {
+        // the last line
+        writer.Reset(output_stream);
+        writer.StartObject();
+        writer.Key("header");
+        WriteJsonHeader(writer, *fit_result);
         writer.EndObject();
+        output->Put('\n');
+      } else {
+        writer.EndArray();
+        writer.EndObject();
+      }
+      output->Close();
+
+    } else if (kOutputJsonColumnarTag == options.output_type) {
+      // the values of a data type are together, so the records are collected first
+      std::unique_ptr<FitResult> fit_result = FitParser(input_fit_file, options.parse);
+      if (fit_result->status != ParseResult::kSuccess) {
+        // error reported in parser
+        return status;
       }
+      const RecordColumns& records = fit_result->result;
+      status.records = records.Size();
 
-      writer.EndArray();
+      std::unique_ptr<DataOutput> output = DataOutput::Create(output_file);
+      JsonOutputStream output_stream(*output);
+      JsonWriter writer(output_stream);
+      writer.StartObject();
+      writer.Key("header");
+      WriteJsonHeader(writer, *fit_result);
+
+      // an array per data type of the header and per developer channel, indexed as the timestamps, null for gaps
+      writer.Key("columns");
+      writer.StartObject();
+      const auto write_column = [&writer, &records](std::string_view name, const auto& is_valid, const auto& value) {
+        writer.Key(name.data(), static_cast<rapidjson::SizeType>(name.size()));
+        writer.StartArray();
+        for (size_t index = 0; index < records.Size(); ++index) {
+          if (is_valid(index)) {
+            writer.Int64(value(index));
+          } else {
+            writer.Null();
+          }
+        }
+        writer.EndArray();
+      };
+      // the shared timestamps go first
+      std::vector<DataType> data_types{DataType::kTypeTimeStamp};
+      for (const auto& header_item : fit_result->header) {
+        DataType data_type;
+        if (DataTypeFromName(header_item.data_tag, data_type) && DataType::kTypeTimeStamp != data_type) {
+          data_types.push_back(data_type);
+        }
+      }
+      for (const DataType data_type : data_types) {
+        write_column(
+            DataTypeToName(data_type),
+            [&records, data_type](const size_t index) { return records.IsValid(index, data_type); },
+            [&records, data_type](const size_t index) { return records.GetValue(index, data_type); });
+      }
+      for (uint32_t channel = 0; channel < fit_result->developer_channels.size(); ++channel) {
+        write_column(
+            fit_result->developer_channels[channel].name,
+            [&records, channel](const size_t index) { return records.IsDeveloperValid(index, channel); },
+            [&records, channel](const size_t index) { return records.GetDeveloperValue(index, channel); });
+      }
       writer.EndObject();
 
-      std::filesystem::remove(output_file);
-      std::ofstream output_stream(output_file, std::ios::out | std::ios::app | std::ios::binary);
-      output_stream.exceptions(std::ios_base::badbit);
-      output_stream.write(string_buffer.GetString(), string_buffer.GetSize());
-      output_stream.close();
+      writer.EndObject();
+      output->Close();
 
-    } else if (kOutputSrtTag == output_type || kOutputVttTag == output_type) {
-      int64_t records_count = 0;
+    } else if (kOutputSrtTag == options.output_type || kOutputVttTag == options.output_type) {
       int64_t first_video_timestamp = 0;
       int64_t first_fit_timestamp = 0;
-      int64_t ascent = 500 * 5;   // default for altitude, because altitude: meters = (value / 5 ) - 500
-      int64_t descent = 500 * 5;  // default for altitude, because altitude: meters = (value / 5 ) - 500
+      OverlayValues overlay_values;
+      overlay_values.ascent = 500 * 5;   // default for altitude, because altitude: meters = (value / 5 ) - 500
+      overlay_values.descent = 500 * 5;  // default for altitude, because altitude: meters = (value / 5 ) - 500
       int64_t previous_altitude = 0;
       bool initial_altitude_set = false;
 
-      // subtitles storage
-      std::vector<SrtItem> subtitles;
-      subtitles.reserve((smoothness + 1) * fit_result->result.size());
+      // subtitles are written while the file is parsed
+      SubtitleWriter subtitles(output_file, kOutputVttTag == options.output_type, options.parse.follow);
 
       std::vector<Record> records_to_process;
-      records_to_process.reserve(smoothness + 1);
+      records_to_process.reserve(options.smoothness + 1);
 
+      // records are consumed as they are decoded, only the previous one is kept for smoothing
+      Record previous_record;
       size_t valid_value_count = 0;
-      for (size_t index = 0; index < fit_result->result.size(); ++index) {
-        const auto& original_record = fit_result->result[index];
+      const auto process_record = [&](const Record& original_record) {
+        const Record start_from_record = previous_record;
+        previous_record = original_record;
+        ++status.records;
 
         const auto record_time_by_type = GetValueByType(original_record, DataType::kTypeTimeStamp);
         const int64_t record_timestamp = record_time_by_type.Valid() ? record_time_by_type.value : 0;
@@ -280,18 +543,18 @@ int main(int argc, char* argv[]) {
         // fit timestamp should not be 0, because it's milliseconds since UTC 00:00 Dec 31 1989
         if (0 == first_fit_timestamp) {
           first_fit_timestamp = record_timestamp;
-          if (offset > 0) {
-            first_fit_timestamp += offset;
-          } else if (offset < 0) {
-            first_video_timestamp = std::abs(offset);
-            subtitles.emplace_back(records_count++, 0, 0, "< .fit data is not available >");
+          if (options.offset > 0) {
+            first_fit_timestamp += options.offset;
+          } else if (options.offset < 0) {
+            first_video_timestamp = std::abs(options.offset);
+            subtitles.Add(0, 0, "< .fit data is not available >");
           }
         }
 
-        if (offset > 0) {
+        if (options.offset > 0) {
           // positive offset, 'offset' second of the data from .fit file will displayed at the first second of the video
           if (record_timestamp < first_fit_timestamp) {
-            continue;
+            return true;
           }
         }
 
@@ -299,11 +562,11 @@ int main(int argc, char* argv[]) {
         records_to_process.clear();
 
         // smoothness
-        if (valid_value_count > 0 && smoothness > 0) {
-          Record start_from = fit_result->result[index - 1];
+        if (valid_value_count > 0 && options.smoothness > 0) {
+          Record start_from = start_from_record;
           Record diff = original_record - start_from;
-          diff = diff / (smoothness + 1);
-          for (int64_t cur_step = 0; cur_step < smoothness; ++cur_step) {
+          diff = diff / (options.smoothness + 1);
+          for (int64_t cur_step = 0; cur_step < options.smoothness; ++cur_step) {
             start_from = start_from + diff;
             records_to_process.push_back(start_from);
           }
@@ -323,102 +586,332 @@ int main(int argc, char* argv[]) {
         ++valid_value_count;
 
         for (auto& record : records_to_process) {
-          std::string output;
-          const auto dst_by_type = GetValueByType(record, DataType::kTypeDistance);
-          if (dst_by_type.Valid()) {
-            const auto distance(NumberToStringPrecision(dst_by_type.value, 100000.0, 5, 2));
-            output += fmt::format("{:>5} km", distance);
-          }
-
-          const auto hr_by_type = GetValueByType(record, DataType::kTypeHeartRate);
-          if (hr_by_type.Valid()) {
-            output += fmt::format("{:>5} bpm", hr_by_type.value);
-          }
-
-          const auto cadence_by_type = GetValueByType(record, DataType::kTypeCadence);
-          if (cadence_by_type.Valid()) {
-            output += fmt::format("{:>5} rpm", cadence_by_type.value);
-          }
-
-          const auto power_by_type = GetValueByType(record, DataType::kTypePower);
-          if (power_by_type.Valid()) {
-            output += fmt::format("{:>6} w", power_by_type.value);
-          }
-
           const auto altitude_by_type = GetValueByType(record, DataType::kTypeAltitude);
           if (altitude_by_type.Valid()) {
             const int64_t altitude_diff = altitude_by_type.value - previous_altitude;
             if (altitude_diff > 0) {
-              ascent += altitude_diff;
+              overlay_values.ascent += altitude_diff;
             } else {
-              descent += altitude_diff;
+              overlay_values.descent += altitude_diff;
             }
             previous_altitude = altitude_by_type.value;
-            output += fmt::format("{:>5} m", (ascent / 5) - 500);
-          }
-
-          const auto speed_by_type = GetValueByType(record, DataType::kTypeSpeed);
-          if (speed_by_type.Valid()) {
-            const auto speed(NumberToStringPrecision(speed_by_type.value, 277.77, 5, 1));
-            output += fmt::format("{:>6} km/h", speed);
-          }
-
-          const auto temp_by_type = GetValueByType(record, DataType::kTypeTemperature);
-          if (temp_by_type.Valid()) {
-            output += fmt::format("{:>4} C", temp_by_type.value);
           }
+          options.overlay->Render(record, overlay_values, subtitles.Text());
 
           const auto timestamp_by_type = GetValueByType(record, DataType::kTypeTimeStamp);
           const int64_t current_record_timestamp = timestamp_by_type.Valid() ? timestamp_by_type.value : 0;
           const int64_t milliseconds = (current_record_timestamp - first_fit_timestamp) + first_video_timestamp;
-          subtitles.emplace_back(records_count++, milliseconds, milliseconds + 60000, output);
-          if (subtitles.size() > 1) {
-            subtitles[subtitles.size() - 2].milliseconds_to = milliseconds;
-          }
+          subtitles.Add(milliseconds, milliseconds + 60000);
+        }
+        return true;
+      };
+
+      std::unique_ptr<FitResult> fit_result = FitParser(input_fit_file, process_record, options.parse);
+      if (fit_result->status != ParseResult::kSuccess) {
+        // error reported in parser, the incomplete output is not left behind
+        subtitles.Finish();
+        if (kStdoutTag != output_file) {
+          std::filesystem::remove(output_file);
         }
+        return status;
       }
+      subtitles.Finish();
+    } else {
+      throw std::runtime_error("unknown output format");
+    }
+    status.success = true;
+  } catch (const std::ios_base::failure& fail) {
+    SPDLOG_ERROR("file problem during processing: {}, check: {}", fail.what(), output_file);
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("exception during processing: {}", e.what());
+  }
+  return status;
+}
 
+// comma separated data type names, the timestamp is always there
+bool ParseFieldsMask(const std::string& fields, ConvertOptions& options) {
+  options.parse.fields_mask = DataTypeToMask(DataType::kTypeTimeStamp);
+  options.parse.developer_fields = false;
+  size_t position = 0;
+  while (position <= fields.size()) {
+    size_t delimiter = fields.find(',', position);
+    if (delimiter == std::string::npos) {
+      delimiter = fields.size();
+    }
+    const std::string_view name(fields.data() + position, delimiter - position);
+    DataType data_type;
+    if (kDeveloperFieldsTag == name) {
+      options.parse.developer_fields = true;
+    } else if (false == DataTypeFromName(name, data_type)) {
+      SPDLOG_ERROR("unknown field specified: '{}'", name);
+      return false;
+    } else {
+      options.parse.fields_mask |= DataTypeToMask(data_type);
+    }
+    position = delimiter + 1;
+  }
+  return true;
+}
 
-      uint64_t saved_size = 0;
-      std::filesystem::remove(output_file);
-      std::ofstream output_stream(output_file, std::ios::out | std::ios::app | std::ios::binary);
-      output_stream.exceptions(std::ios_base::badbit);
-      // differentiate between .srt and .vtt
-      char milliseconds_delimiter = ',';
-      if (kOutputVttTag == output_type) {
-        milliseconds_delimiter = '.';
-        output_stream.write(kVttHeaderTag.data(), kVttHeaderTag.size());
-      }
+size_t GetJobsCount(const size_t requested_jobs) {
+  if (requested_jobs > 0) {
+    return requested_jobs;
+  }
+  const size_t hardware_jobs = std::thread::hardware_concurrency();
+  return hardware_jobs > 0 ? hardware_jobs : 1;
+}
+
+bool IsFitFile(const std::filesystem::path& path) {
+  std::string extension(path.extension().string());
+  std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char symbol) {
+    return static_cast<char>(std::tolower(symbol));
+  });
+  return extension == kFitExtensionTag;
+}
 
-      for (const auto item : subtitles) {
-        if (kOutputVttTag == output_type) {
-          milliseconds_delimiter = '.';
+// files are taken as is, directories are expanded to the .fit files they contain
+std::vector<std::filesystem::path> CollectInputFiles(const std::vector<std::string>& inputs) {
+  std::vector<std::filesystem::path> files;
+  for (const auto& input : inputs) {
+    if (std::filesystem::is_directory(input)) {
+      for (const auto& entry : std::filesystem::directory_iterator(input)) {
+        if (entry.is_regular_file() && IsFitFile(entry.path())) {
+          files.push_back(entry.path());
         }
-        const Time time_from(GetTime(item.milliseconds_from));
-        const Time time_to(GetTime(item.milliseconds_to));
-        const auto file_out(
-            fmt::format("{}\n{:0>2d}:{:0>2d}:{:0>2d}{}{:0>3d} --> {:0>2d}:{:0>2d}:{:0>2d}{}{:0>3d}\n{}\n\n",
-                        item.frame,
-                        time_from.hours,
-                        time_from.minutes,
-                        time_from.seconds,
-                        milliseconds_delimiter,
-                        time_from.milliseconds,
-                        time_to.hours,
-                        time_to.minutes,
-                        time_to.seconds,
-                        milliseconds_delimiter,
-                        time_to.milliseconds,
-                        item.data));
-        output_stream.write(file_out.c_str(), file_out.size());
-        saved_size += file_out.size();
       }
     } else {
-      throw std::runtime_error("unknown output format");
+      files.emplace_back(input);
     }
-  } catch (const std::ios_base::failure& fail) {
-    SPDLOG_ERROR("file problem during processing: {}, check: {}", fail.what(), output_file);
+  }
+  return files;
+}
+
+int VerifyFiles(const std::vector<std::string>& inputs) {
+  size_t valid_count = 0;
+  const auto files = CollectInputFiles(inputs);
+  for (const auto& file : files) {
+    if (FitVerify(file.string())) {
+      ++valid_count;
+      SPDLOG_INFO("valid: {}", file.string());
+    } else {
+      SPDLOG_ERROR("invalid: {}", file.string());
+    }
+  }
+  return (false == files.empty() && valid_count == files.size()) ? 0 : 1;
+}
+
+int BatchConvert(const std::vector<std::string>& inputs,
+                 const std::string& output_dir,
+                 const ConvertOptions& options,
+                 const size_t jobs) {
+  struct BatchItem {
+    std::filesystem::path input;
+    std::filesystem::path output;
+    uint64_t input_size{0};
+    ConvertStatus status;
+    std::chrono::milliseconds duration{0};
+  };
+
+  std::vector<BatchItem> items;
+  for (auto& input : CollectInputFiles(inputs)) {
+    items.emplace_back().input = std::move(input);
+  }
+
+  if (items.empty()) {
+    SPDLOG_ERROR("no .fit files found to convert");
     return 1;
+  }
+
+  // files with the same name from different directories get a numbered suffix instead of one output
+  std::filesystem::create_directories(output_dir);
+  const std::string extension = fmt::format(".{}", GetOutputExtension(options.output_type));
+  std::set<std::filesystem::path> outputs;
+  for (auto& item : items) {
+    const std::filesystem::path stem = item.input.stem();
+    item.output = std::filesystem::path(output_dir) / stem;
+    item.output += extension;
+    for (size_t suffix = 2; false == outputs.insert(item.output).second; ++suffix) {
+      item.output = std::filesystem::path(output_dir) / stem;
+      item.output += fmt::format("-{}{}", suffix, extension);
+    }
+    if (item.output.stem() != stem) {
+      SPDLOG_WARN("output name is taken: {} -> {}", item.input.string(), item.output.string());
+    }
+  }
+
+  const size_t workers_count = std::min(GetJobsCount(jobs), items.size());
+  SPDLOG_INFO("converting {} files on {} threads", items.size(), workers_count);
+
+  const auto batch_start = std::chrono::steady_clock::now();
+  std::atomic<size_t> next_item{0};
+  std::vector<std::thread> workers;
+  workers.reserve(workers_count);
+  for (size_t worker = 0; worker < workers_count; ++worker) {
+    workers.emplace_back([&items, &next_item, &options]() {
+      for (size_t index = next_item++; index < items.size(); index = next_item++) {
+        auto& item = items[index];
+        const auto item_start = std::chrono::steady_clock::now();
+        std::error_code size_error;
+        item.input_size = std::filesystem::file_size(item.input, size_error);
+        item.status = ConvertFile(item.input.string(), item.output.string(), options);
+        item.duration =
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - item_start);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  const auto batch_duration =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - batch_start);
+
+  size_t converted_count = 0;
+  uint64_t converted_size = 0;
+  size_t converted_records = 0;
+  for (const auto& item : items) {
+    if (item.status.success) {
+      ++converted_count;
+      converted_size += item.input_size;
+      converted_records += item.status.records;
+      SPDLOG_INFO("ok: {} -> {}, records: {}, time: {} ms",
+                  item.input.string(),
+                  item.output.string(),
+                  item.status.records,
+                  item.duration.count());
+    } else {
+      SPDLOG_ERROR("failed: {}", item.input.string());
+    }
+  }
+
+  const double seconds = std::max<double>(static_cast<double>(batch_duration.count()) / 1000.0, 0.001);
+  SPDLOG_INFO("converted {} of {} files, records: {}, time: {:.3f} s, {:.1f} files/s, {:.1f} MB/s",
+              converted_count,
+              items.size(),
+              converted_records,
+              seconds,
+              static_cast<double>(converted_count) / seconds,
+              static_cast<double>(converted_size) / (1024.0 * 1024.0) / seconds);
+  return converted_count == items.size() ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+  spdlog::set_pattern(kLogPattern);
+
+  cxxopts::Options cmd_options("FIT converter", "FIT telemetry converter to SRT or JSON");
+  cmd_options.add_options()                                                               //
+      ("i,input", "", cxxopts::value<std::vector<std::string>>())                         //
+      ("o,output", "", cxxopts::value<std::string>())                                     //
+      ("d,output-dir", "", cxxopts::value<std::string>())                                 //
+      ("j,jobs", "", cxxopts::value<size_t>()->default_value("0"))                        //
+      ("verify", "")                                                                      //
+      ("h,help", "")                                                                      //
+      ("t,type", "", cxxopts::value<std::string>()->default_value(kOutputSrtTag.data()))  //
+      ("f,offset", "", cxxopts::value<int64_t>()->default_value("0"))                     //
+      ("s,smooth", "", cxxopts::value<uint8_t>()->default_value("0"))                     //
+      ("fields", "", cxxopts::value<std::string>())                                       //
+      ("index", "")                                                                       //
+      ("from", "", cxxopts::value<int64_t>()->default_value("0"))                         //
+      ("to", "", cxxopts::value<int64_t>())                                               //
+      ("duration", "", cxxopts::value<int64_t>())                                         //
+      ("follow", "", cxxopts::value<uint32_t>()->implicit_value("0"))                     //
+      ("cache", "", cxxopts::value<std::string>())                                        //
+      ("template", "", cxxopts::value<std::string>());                                    //
+  const auto cmd_result = cmd_options.parse(argc, argv);
+
+  // the converted data goes to stdout, so the log goes to stderr
+  if (cmd_result.count("output") > 0 && kStdoutTag == cmd_result["output"].as<std::string>()) {
+    spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
+    spdlog::set_pattern(kLogPattern);
+  }
+
+  if ((argc < 4 && cmd_result.count("verify") == 0) || cmd_result.count("help") > 0 ||
+      cmd_result.count("input") == 0) {
+    std::cout << kBanner << std::endl;
+    std::cout << kHelp << std::endl;
+    return 1;
+  }
+
+  const std::vector<std::string> inputs(cmd_result["input"].as<std::vector<std::string>>());
+  if (cmd_result.count("verify") > 0) {
+    return VerifyFiles(inputs);
+  }
+
+  ConvertOptions options;
+  options.output_type = cmd_result["type"].as<std::string>();
+  options.offset = cmd_result["offset"].as<int64_t>();
+  options.smoothness = cmd_result["smooth"].as<uint8_t>();
+  options.parse.write_index = cmd_result.count("index") > 0;
+  if (cmd_result.count("cache") > 0) {
+    options.parse.cache_dir = cmd_result["cache"].as<std::string>();
+  }
+  if (cmd_result.count("follow") > 0) {
+    options.parse.follow = true;
+    options.parse.follow_idle_timeout = std::chrono::seconds(cmd_result["follow"].as<uint32_t>());
+  }
+  if (cmd_result.count("fields") > 0 && false == ParseFieldsMask(cmd_result["fields"].as<std::string>(), options)) {
+    return 1;
+  }
+  options.overlay = OverlayTemplate::Compile(
+      cmd_result.count("template") > 0 ? cmd_result["template"].as<std::string>() : kDefaultOverlayTemplate);
+  if (nullptr == options.overlay) {
+    return 1;
+  }
+
+  try {
+    const bool json_output = options.output_type == kOutputJsonTag || options.output_type == kOutputJsonColumnarTag ||
+                             options.output_type == kOutputNdjsonTag;
+    if (false == json_output && options.output_type != kOutputSrtTag && options.output_type != kOutputVttTag) {
+      SPDLOG_ERROR("unknown output specified: '{}', only srt, vtt, json, json-columnar and ndjson supported",
+                   options.output_type);
+      return 1;
+    }
+
+    if (json_output &&
+        (options.offset != 0 || options.smoothness != 0 || cmd_result.count("template") > 0)) {
+      SPDLOG_WARN("smoothness, offset or template valid only for .srt output format");
+    }
+
+    if (options.smoothness > 9) {
+      SPDLOG_ERROR("smoothness can not be more than 9");
+      return 1;
+    }
+
+    options.parse.range_from = cmd_result["from"].as<int64_t>();
+    if (options.parse.range_from < 0) {
+      SPDLOG_ERROR("start of the time range can not be negative");
+      return 1;
+    }
+    if (cmd_result.count("to") > 0 && cmd_result.count("duration") > 0) {
+      SPDLOG_ERROR("only one of the --to or --duration can be specified");
+      return 1;
+    }
+    if (cmd_result.count("to") > 0) {
+      options.parse.range_to = cmd_result["to"].as<int64_t>();
+    } else if (cmd_result.count("duration") > 0) {
+      const int64_t duration = cmd_result["duration"].as<int64_t>();
+      options.parse.range_to = duration >= 0 ? options.parse.range_from + duration : -1;
+    }
+    if (options.parse.range_to < options.parse.range_from) {
+      SPDLOG_ERROR("end of the time range can not be before its start");
+      return 1;
+    }
+
+    if (cmd_result.count("output-dir") > 0) {
+      return BatchConvert(inputs, cmd_result["output-dir"].as<std::string>(), options, cmd_result["jobs"].as<size_t>());
+    }
+
+    if (inputs.size() != 1 || cmd_result.count("output") == 0) {
+      SPDLOG_ERROR("single file mode requires one input and one output, use -d for batch conversion");
+      return 1;
+    }
+
+    // a single file is decoded in order by one thread unless -j asks for more, records are written as they come
+    if (cmd_result.count("jobs") > 0) {
+      options.parse.decode_threads = GetJobsCount(cmd_result["jobs"].as<size_t>());
+    }
+    if (false == ConvertFile(inputs.front(), cmd_result["output"].as<std::string>(), options).success) {
+      return 1;
+    }
   } catch (const std::exception& e) {
     SPDLOG_ERROR("exception during processing: {}", e.what());
     return 1;
@@ -0,0 +1,126 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#include "data_output.h"
+
+#include <cerrno>
+#include <ios>
+#include <system_error>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+std::ios_base::failure OutputError(const char* operation) {
+  return std::ios_base::failure(operation, std::error_code(errno, std::generic_category()));
+}
+
+}  // namespace
+
+std::unique_ptr<DataOutput> DataOutput::Create(const std::string& output_name) {
+#if !defined(_WIN32)
+  if (kStdoutTag == output_name) {
+    return std::unique_ptr<DataOutput>(new DataOutput(STDOUT_FILENO, false));
+  }
+  const int file_descriptor = open(output_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#else
+  if (kStdoutTag == output_name) {
+    _setmode(_fileno(stdout), _O_BINARY);
+    return std::unique_ptr<DataOutput>(new DataOutput(_fileno(stdout), false));
+  }
+  const int file_descriptor = _open(output_name.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+  if (file_descriptor < 0) {
+    throw OutputError("output file opening error");
+  }
+  return std::unique_ptr<DataOutput>(new DataOutput(file_descriptor, true));
+}
+
+DataOutput::~DataOutput() {
+  // the data is flushed only by Close, the destructor must not throw
+  if (own_descriptor_ && file_descriptor_ >= 0) {
+#if !defined(_WIN32)
+    close(file_descriptor_);
+#else
+    _close(file_descriptor_);
+#endif
+  }
+}
+
+void DataOutput::Write(const char* data, const size_t size) {
+  if (buffer_.size() + size > kBufferSize) {
+    Flush();
+    // large blocks go straight to the descriptor
+    if (size >= kBufferSize) {
+      WriteDescriptor(data, size);
+      return;
+    }
+  }
+  buffer_.insert(buffer_.end(), data, data + size);
+}
+
+void DataOutput::Close() {
+  Flush();
+  if (own_descriptor_ && file_descriptor_ >= 0) {
+#if !defined(_WIN32)
+    const int result = close(file_descriptor_);
+#else
+    const int result = _close(file_descriptor_);
+#endif
+    file_descriptor_ = -1;
+    if (result != 0) {
+      throw OutputError("output file closing error");
+    }
+  }
+}
+
+void DataOutput::Flush() {
+  WriteDescriptor(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void DataOutput::WriteDescriptor(const char* data, size_t size) {
+  while (size > 0) {
+#if !defined(_WIN32)
+    const ssize_t written = write(file_descriptor_, data, size);
+#else
+    const int written = _write(file_descriptor_, data, static_cast<unsigned int>(size));
+#endif
+    if (written < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      throw OutputError("output file writing error");
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+}
@@ -0,0 +1,74 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+inline constexpr std::string_view kStdoutTag("-");
+
+// output file or stdout written through the descriptor in large blocks, so the output can be piped
+// to the next tool without temporary files. errors are thrown as std::ios_base::failure like the streams do
+class DataOutput final {
+ public:
+  ~DataOutput();
+
+  // "-" is stdout, anything else is a file path (/dev/fd/N for an inherited descriptor), throws if it can't be opened
+  static std::unique_ptr<DataOutput> Create(const std::string& output_name);
+
+  void Write(const char* data, const size_t size);
+
+  void Write(const std::string_view data) { Write(data.data(), data.size()); }
+
+  // single symbols of the generated text
+  void Put(const char symbol) {
+    if (buffer_.size() == kBufferSize) {
+      Flush();
+    }
+    buffer_.push_back(symbol);
+  }
+
+  // writes the buffered data to the descriptor
+  void Flush();
+
+  // flushes the buffered data and closes the file, stdout stays open
+  void Close();
+
+ private:
+  static constexpr size_t kBufferSize = 1024 * 1024;
+
+  DataOutput(const int file_descriptor, const bool own_descriptor)
+      : file_descriptor_(file_descriptor), own_descriptor_(own_descriptor) {
+    buffer_.reserve(kBufferSize);
+  }
+
+  void WriteDescriptor(const char* data, size_t size);
+
+  int file_descriptor_{-1};
+  bool own_descriptor_{false};
+  std::vector<char> buffer_;
+};
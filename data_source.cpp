@@ -0,0 +1,359 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#include "data_source.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include "fitsdk/fit.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+DataSource::Status DataSource::ReadDataInternal(std::istream& stream, Buffer& buffer) {
+  try {
+    stream.read(buffer.GetBufferPtr(), buffer.GetBufferSize());
+    buffer.SetDataSize(stream.gcount());
+    if (stream.eof()) {
+      return Status::kEndOfFile;
+    } else if (stream.good()) {
+      return Status::kContinueRead;
+    }
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("input file reading error: {}", e.what());  //
+  }
+  return Status::kError;
+}
+
+DataSourceFile::DataSourceFile(std::string source_name)
+    : DataSource(DataSource::Type::kFile), source_name_(std::move(source_name)) {
+  stream_ = std::make_unique<std::ifstream>(source_name_, std::ios::in | std::ios::app | std::ios::binary);
+  stream_->exceptions(std::ios_base::badbit);
+}
+
+DataSource::Status DataSourceFile::ReadData(Buffer& buffer) {
+  return ReadDataInternal(*stream_.get(), buffer);  //
+}
+
+DataSourceFollow::DataSourceFollow(const std::string& source_name, const std::chrono::milliseconds idle_timeout)
+    : DataSource(DataSource::Type::kFile),
+      source_name_(source_name),
+      stream_(source_name, std::ios::in | std::ios::binary),
+      idle_timeout_(idle_timeout) {
+  stream_.exceptions(std::ios_base::badbit);
+}
+
+DataSource::Status DataSourceFollow::ReadData(Buffer& buffer) {
+  if (false == stream_.is_open()) {
+    SPDLOG_ERROR("input file opening error");
+    return Status::kError;
+  }
+  try {
+    const auto idle_start = std::chrono::steady_clock::now();
+    bool idle_polled{false};  // nothing was appended for a poll interval
+    for (;;) {
+      // the bytes held back by the previous read go first
+      char* const data = buffer.GetBufferPtr();
+      std::memcpy(data, held_.data(), held_size_);
+      size_t data_size = held_size_;
+      held_size_ = 0;
+
+      // the end of the file is not final, the stream is read again after the data was appended
+      size_t read_size = buffer.GetBufferSize() - data_size;
+      if (final_size_ > 0) {
+        read_size = static_cast<size_t>(std::min<uint64_t>(read_size, final_size_ - std::min(position_, final_size_)));
+      }
+      stream_.clear();
+      stream_.read(data + data_size, static_cast<std::streamsize>(read_size));
+      const size_t appended_size = static_cast<size_t>(stream_.gcount());
+      position_ += appended_size;
+      data_size += appended_size;
+
+      if (0 == appended_size && 0 == final_size_) {
+        ReadFinalSize();
+      }
+      // the last bytes can be the file crc appended before the data size was written to the header,
+      // they are handed over only after the file was idle for a poll interval or the header is complete
+      if (0 == final_size_ && (appended_size > 0 || false == idle_polled)) {
+        held_size_ = std::min(held_.size(), data_size);
+        data_size -= held_size_;
+        std::memcpy(held_.data(), data + data_size, held_size_);
+      }
+      buffer.SetDataSize(data_size);
+      if (final_size_ > 0 && position_ >= final_size_) {
+        return Status::kEndOfFile;
+      }
+      if (data_size > 0) {
+        return Status::kContinueRead;
+      }
+      if (idle_timeout_.count() > 0 && std::chrono::steady_clock::now() - idle_start >= idle_timeout_) {
+        std::memcpy(data, held_.data(), held_size_);
+        buffer.SetDataSize(held_size_);
+        held_size_ = 0;
+        return Status::kEndOfFile;
+      }
+      std::this_thread::sleep_for(kPollInterval);
+      idle_polled = true;
+    }
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("input file reading error: {}", e.what());  //
+  }
+  return Status::kError;
+}
+
+void DataSourceFollow::ReadFinalSize() {
+  // the writer fills in the data size of the header when the file is complete
+  std::ifstream header_stream(source_name_, std::ios::in | std::ios::binary);
+  uint8_t header[FIT_FILE_HDR_SIZE]{};
+  header_stream.read(reinterpret_cast<char*>(header), sizeof(header));
+  // the data size is in the first 12 bytes of every header
+  constexpr uint8_t kDataSizeEnd = FIT_FILE_HDR_SIZE - FIT_FILE_CRC_SIZE;
+  if (header_stream.gcount() < kDataSizeEnd || header[0] < kDataSizeEnd) {
+    return;
+  }
+  const uint32_t data_size = static_cast<uint32_t>(header[4]) | (static_cast<uint32_t>(header[5]) << 8) |
+                             (static_cast<uint32_t>(header[6]) << 16) | (static_cast<uint32_t>(header[7]) << 24);
+  if (data_size > 0) {
+    final_size_ = static_cast<uint64_t>(header[0]) + data_size + FIT_FILE_CRC_SIZE;
+  }
+}
+
+DataSourceStdin::DataSourceStdin() : DataSource(DataSource::Type::kStdin) {
+#if !defined(_WIN32)
+  if (pipe(wake_pipe_) != 0) {
+    // reads are not interruptible then, they still end with the pipe
+    wake_pipe_[0] = wake_pipe_[1] = -1;
+  }
+#endif
+}
+
+DataSourceStdin::~DataSourceStdin() {
+#if !defined(_WIN32)
+  if (wake_pipe_[0] >= 0) {
+    close(wake_pipe_[0]);
+    close(wake_pipe_[1]);
+  }
+#endif
+}
+
+void DataSourceStdin::Interrupt() {
+#if !defined(_WIN32)
+  if (wake_pipe_[1] >= 0) {
+    const char wake{0};
+    while (write(wake_pipe_[1], &wake, sizeof(wake)) < 0 && EINTR == errno) {
+    }
+  }
+#endif
+}
+
+DataSource::Status DataSourceStdin::ReadData(Buffer& buffer) {
+#if !defined(_WIN32)
+  // a pipe returns what is available, so the buffer is filled with several reads
+  size_t data_size{0};
+  while (data_size < buffer.GetBufferSize()) {
+    pollfd poll_fds[2] = {{STDIN_FILENO, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+    if (poll(poll_fds, wake_pipe_[0] >= 0 ? 2 : 1, -1) < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      SPDLOG_ERROR("stdin polling error: {}", std::strerror(errno));
+      buffer.SetDataSize(data_size);
+      return Status::kError;
+    }
+    if (0 != poll_fds[1].revents) {
+      // interrupted, the reader is not needed anymore
+      buffer.SetDataSize(data_size);
+      return Status::kEndOfFile;
+    }
+    const ssize_t read_size =
+        read(STDIN_FILENO, buffer.GetBufferPtr() + data_size, buffer.GetBufferSize() - data_size);
+    if (read_size < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      SPDLOG_ERROR("stdin reading error: {}", std::strerror(errno));
+      buffer.SetDataSize(data_size);
+      return Status::kError;
+    }
+    if (0 == read_size) {
+      buffer.SetDataSize(data_size);
+      return Status::kEndOfFile;
+    }
+    data_size += static_cast<size_t>(read_size);
+  }
+  buffer.SetDataSize(data_size);
+  return Status::kContinueRead;
+#else
+  return ReadDataInternal(std::cin, buffer);
+#endif
+}
+
+DataSourceMappedFile::~DataSourceMappedFile() {
+#if !defined(_WIN32)
+  munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+std::unique_ptr<DataSourceMappedFile> DataSourceMappedFile::Create(const std::string& source_name) {
+#if !defined(_WIN32)
+  const int file_descriptor = open(source_name.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    return nullptr;
+  }
+  auto mapped_source = Map(file_descriptor, Type::kMappedFile);
+  // the mapping keeps its own reference to the file
+  close(file_descriptor);
+  return mapped_source;
+#else
+  return nullptr;
+#endif
+}
+
+std::unique_ptr<DataSourceMappedFile> DataSourceMappedFile::CreateFromStdin() {
+#if !defined(_WIN32)
+  // only the whole file can be mapped, stdin could be already read partially by the parent process
+  if (lseek(STDIN_FILENO, 0, SEEK_CUR) != 0) {
+    return nullptr;
+  }
+  return Map(STDIN_FILENO, Type::kStdin);
+#else
+  return nullptr;
+#endif
+}
+
+std::unique_ptr<DataSourceMappedFile> DataSourceMappedFile::Map(const int file_descriptor, const Type type) {
+#if !defined(_WIN32)
+  struct stat file_stat {};
+  if (fstat(file_descriptor, &file_stat) != 0 || false == S_ISREG(file_stat.st_mode) || file_stat.st_size <= 0 ||
+      static_cast<uint64_t>(file_stat.st_size) > std::numeric_limits<uint32_t>::max()) {
+    // FIT data size is 32 bit, so bigger files are handled (and rejected) by the stream path
+    return nullptr;
+  }
+
+  const size_t size = static_cast<size_t>(file_stat.st_size);
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+  madvise(mapping, size, MADV_SEQUENTIAL);
+  return std::unique_ptr<DataSourceMappedFile>(
+      new DataSourceMappedFile(type, static_cast<const char*>(mapping), size));
+#else
+  return nullptr;
+#endif
+}
+
+DataSource::Status DataSourceMappedFile::ReadData(Buffer& buffer) {
+  // the whole file is returned with the first read
+  buffer.SetExternalData(data_, consumed_ ? 0 : size_);
+  consumed_ = true;
+  return Status::kEndOfFile;
+}
+
+DataSourceReadAhead::DataSourceReadAhead(std::unique_ptr<DataSource> source)
+    : DataSource(source->GetType()), source_(std::move(source)) {
+  reader_ = std::thread(&DataSourceReadAhead::ReadLoop, this);
+}
+
+DataSourceReadAhead::~DataSourceReadAhead() {
+  // the reader can wait in a read of a pipe that is not closed yet when decoding stopped early
+  stop_.store(true);
+  source_->Interrupt();
+  Notify();
+  reader_.join();
+}
+
+void DataSourceReadAhead::Notify() {
+  // the lock orders the index update before the check of the parked thread
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  changed_.notify_all();
+}
+
+void DataSourceReadAhead::ReadLoop() {
+  for (size_t head = 0;; ++head) {
+    if (head - tail_.load(std::memory_order_acquire) == kSlotsCount) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [&] { return stop_.load() || head - tail_.load(std::memory_order_acquire) < kSlotsCount; });
+    }
+    if (stop_.load()) {
+      return;
+    }
+
+    Slot& slot = slots_[head % kSlotsCount];
+    slot.status = source_->ReadData(slot.buffer);
+    head_.store(head + 1, std::memory_order_release);
+    Notify();
+    if (Status::kContinueRead != slot.status) {
+      return;
+    }
+  }
+}
+
+DataSource::Status DataSourceReadAhead::ReadData(Buffer& buffer) {
+  // the consumer is the only writer of the tail
+  if (holding_slot_) {
+    holding_slot_ = false;
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    Notify();
+  }
+  if (Status::kContinueRead != last_status_) {
+    buffer.SetExternalData(nullptr, 0);
+    return last_status_;
+  }
+
+  const size_t tail = tail_.load(std::memory_order_relaxed);
+  if (head_.load(std::memory_order_acquire) == tail) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return head_.load(std::memory_order_acquire) != tail; });
+  }
+  const Slot& slot = slots_[tail % kSlotsCount];
+  buffer.SetExternalData(slot.buffer.GetDataPtr(), slot.buffer.GetDataSize());
+  holding_slot_ = true;
+  last_status_ = slot.status;
+  return last_status_;
+}
+
+std::unique_ptr<DataSource> CreateDataSource(const std::string& source_name) {
+  if (kStdinTag == source_name) {
+    if (auto mapped_stdin = DataSourceMappedFile::CreateFromStdin()) {
+      return mapped_stdin;
+    }
+    return std::make_unique<DataSourceReadAhead>(std::make_unique<DataSourceStdin>());
+  }
+  if (auto mapped_source = DataSourceMappedFile::Create(source_name)) {
+    return mapped_source;
+  }
+  return std::make_unique<DataSourceReadAhead>(std::make_unique<DataSourceFile>(source_name));
+}
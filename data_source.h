@@ -0,0 +1,220 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+inline constexpr std::string_view kStdinTag("stdin");
+
+struct Buffer final {
+ public:
+  Buffer(const size_t buffer_size) { buffer_.resize(buffer_size); }
+
+  // data was written into the own storage of the buffer
+  void SetDataSize(const size_t size) {
+    data_ptr_ = buffer_.data();
+    data_size_ = size;
+  }
+
+  // data lives in memory owned by the data source (file mapping), no copy is made
+  void SetExternalData(const char* data_ptr, const size_t size) {
+    data_ptr_ = data_ptr;
+    data_size_ = size;
+  }
+
+  size_t GetDataSize() const { return data_size_; }
+
+  size_t GetBufferSize() const { return buffer_.size(); }
+
+  char* GetBufferPtr() { return buffer_.data(); }
+
+  const char* GetDataPtr() const { return data_ptr_; }
+
+ private:
+  std::vector<char> buffer_;
+  const char* data_ptr_{nullptr};
+  size_t data_size_{0};
+};
+
+class DataSource {
+ public:
+  enum class Type {
+    kFile,
+    kMappedFile,
+    kStdin,
+  };
+
+  enum class Status {
+    kContinueRead,
+    kEndOfFile,
+    kError,
+  };
+
+  DataSource(Type type) : type_(type) {}
+
+  virtual ~DataSource() = default;
+
+  virtual Status ReadData(Buffer& buffer) = 0;
+
+  // whole content as one read-only block, empty when the source can only be streamed
+  virtual std::string_view GetContiguousData() const { return {}; }
+
+  // wakes a read that waits for data on another thread, the source is not read after that
+  virtual void Interrupt() {}
+
+  Type GetType() const { return type_; }
+
+ protected:
+  Status ReadDataInternal(std::istream& stream, Buffer& buffer);
+
+ private:
+  Type type_{Type::kFile};
+};
+
+class DataSourceFile : public DataSource {
+ public:
+  DataSourceFile(std::string source_name);
+
+  Status ReadData(Buffer& buffer) override;
+
+ private:
+  std::string source_name_;
+  std::unique_ptr<std::istream> stream_;
+};
+
+// file that is still being written: at the end of the file the source waits for appended data,
+// the end is reported after the file did not grow for the idle timeout, zero timeout waits forever
+// while waiting the file header is read again, once it has the data size the end is reported at the end of the file
+class DataSourceFollow : public DataSource {
+ public:
+  DataSourceFollow(const std::string& source_name, const std::chrono::milliseconds idle_timeout);
+
+  // returns as soon as any data is available, the buffer is not waited to be filled
+  Status ReadData(Buffer& buffer) override;
+
+  // header, data and crc sizes of the complete file, 0 while the header has no data size
+  uint64_t GetFinalSize() const { return final_size_; }
+
+ private:
+  static constexpr std::chrono::milliseconds kPollInterval{200};
+
+  void ReadFinalSize();
+
+  std::string source_name_;
+  std::ifstream stream_;
+  std::chrono::milliseconds idle_timeout_;
+  uint64_t position_{0};
+  uint64_t final_size_{0};
+  std::array<char, 2> held_{};
+  size_t held_size_{0};
+};
+
+// reads the stdin descriptor directly with reads as large as the buffer, std::cin is not involved,
+// a read that waits for the pipe is woken through the wake pipe
+class DataSourceStdin : public DataSource {
+ public:
+  DataSourceStdin();
+  ~DataSourceStdin() override;
+
+  Status ReadData(Buffer& buffer) override;
+
+  void Interrupt() override;
+
+ private:
+  int wake_pipe_[2]{-1, -1};
+};
+
+// read-only memory mapping of the whole file, the decoder reads straight from the mapped pages
+class DataSourceMappedFile : public DataSource {
+ public:
+  ~DataSourceMappedFile() override;
+
+  // returns nullptr if the file can not be mapped (empty file, special file or unsupported platform)
+  static std::unique_ptr<DataSourceMappedFile> Create(const std::string& source_name);
+  // stdin redirected from a regular file is mapped as well, the source keeps the stdin type
+  static std::unique_ptr<DataSourceMappedFile> CreateFromStdin();
+
+  Status ReadData(Buffer& buffer) override;
+
+  std::string_view GetContiguousData() const override { return std::string_view(data_, size_); }
+
+ private:
+  DataSourceMappedFile(const Type type, const char* data, const size_t size)
+      : DataSource(type), data_(data), size_(size) {}
+
+  static std::unique_ptr<DataSourceMappedFile> Map(const int file_descriptor, const Type type);
+
+  const char* data_{nullptr};
+  size_t size_{0};
+  bool consumed_{false};
+};
+
+// streams the wrapped source on a reader thread, so reading of the next buffers overlaps with the decoding,
+// filled buffers are handed over to the consumer without a copy through a single producer single consumer ring
+class DataSourceReadAhead final : public DataSource {
+ public:
+  explicit DataSourceReadAhead(std::unique_ptr<DataSource> source);
+  ~DataSourceReadAhead() override;
+
+  // the buffer points to the ring storage, the data is valid until the next call
+  Status ReadData(Buffer& buffer) override;
+
+ private:
+  static constexpr size_t kSlotsCount = 4;
+  static constexpr size_t kSlotSize = 256 * 1024;
+
+  struct Slot {
+    Buffer buffer{kSlotSize};
+    Status status{Status::kContinueRead};
+  };
+
+  void ReadLoop();
+  void Notify();
+
+  std::unique_ptr<DataSource> source_;
+  std::array<Slot, kSlotsCount> slots_;
+  std::atomic<size_t> head_{0};  // slots filled by the reader thread
+  std::atomic<size_t> tail_{0};  // slots released by the consumer
+  std::atomic<bool> stop_{false};
+  bool holding_slot_{false};  // consumer holds the slot at tail_ until the next read
+  Status last_status_{Status::kContinueRead};
+  // only to park a thread on an empty or a full ring
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::thread reader_;
+};
+
+// stdin is streamed, regular files are mapped with a fallback to the stream reading
+std::unique_ptr<DataSource> CreateDataSource(const std::string& source_name);
@@ -0,0 +1,80 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#include "decoder.h"
+
+void FitDecoder::Reset(const bool read_file_header) {
+  FitConvert_Init(&state_, read_file_header ? FIT_TRUE : FIT_FALSE);
+}
+
+void FitDecoder::ContinueFrom(const FIT_CONVERT_STATE& state) {
+  state_ = state;
+  state_.file_bytes_left = 0;
+  state_.data_offset = 0;
+}
+
+FIT_CONVERT_RETURN FitDecoder::Read(const void* data, const size_t size) {
+  return FitConvert_Read(&state_, data, static_cast<FIT_UINT32>(size));
+}
+
+bool FitDecoder::SetMessageFilter(const FIT_MESG_NUM* mesg_nums, const size_t count) {
+  if (count > FIT_MESG_FILTER_MAX) {
+    return false;
+  }
+  return FIT_TRUE == FitConvert_SetMesgFilter(&state_, mesg_nums, static_cast<FIT_UINT8>(count));
+}
+
+void FitDecoder::SetStartTime(const FIT_DATE_TIME start_time) {
+  FitConvert_SetStartTime(&state_, start_time);
+}
+
+void FitDecoder::SetOpenEnded(const bool open_ended) {
+  FitConvert_SetOpenEnded(&state_, open_ended ? FIT_TRUE : FIT_FALSE);
+}
+
+void FitDecoder::SetFileBytesLeft(const uint32_t file_bytes_left) {
+  FitConvert_SetFileBytesLeft(&state_, file_bytes_left);
+}
+
+void FitDecoder::SetFieldFilter(const FIT_MESG_NUM mesg_num, const FIT_UINT8* field_nums, const size_t count) {
+  FitConvert_SetFieldFilter(&state_, mesg_num, field_nums, static_cast<FIT_UINT8>(count));
+}
+
+FIT_MESG_NUM FitDecoder::GetMessageNumber() {
+  return FitConvert_GetMessageNumber(&state_);
+}
+
+const FIT_UINT8* FitDecoder::GetMessageData() {
+  return FitConvert_GetMessageData(&state_);
+}
+
+const FIT_FIELD_CONVERT* FitDecoder::GetMessageFields(FIT_UINT8& count) {
+  return FitConvert_GetMessageFields(&state_, &count);
+}
+
+const FIT_DEV_FIELD_DEF* FitDecoder::GetDevFields(FIT_UINT8& count) {
+  return FitConvert_GetDevFields(&state_, &count);
+}
+
+const FIT_UINT8* FitDecoder::GetDevData(FIT_UINT8& size) {
+  return FitConvert_GetDevData(&state_, &size);
+}
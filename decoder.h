@@ -0,0 +1,93 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fitsdk/fit_convert.h"
+
+// Reentrant wrapper around the FIT SDK converter: every instance owns its own
+// converter state, so one decoder per thread can run without any locking.
+class FitDecoder final {
+ public:
+  explicit FitDecoder(const bool read_file_header = true) { Reset(read_file_header); }
+
+  FitDecoder(const FitDecoder&) = delete;
+  FitDecoder& operator=(const FitDecoder&) = delete;
+
+  // restart decoding from the beginning of the stream
+  void Reset(const bool read_file_header = true);
+
+  // feed the next chunk of the stream, see FitConvert_Read for return values
+  // call again with the same chunk after FIT_CONVERT_MESSAGE_AVAILABLE to continue
+  FIT_CONVERT_RETURN Read(const void* data, const size_t size);
+
+  // report only data messages with the listed global numbers, other messages are skipped by their size
+  // returns false if there are more than FIT_MESG_FILTER_MAX numbers, see FitConvert_SetMesgFilter for details
+  bool SetMessageFilter(const FIT_MESG_NUM* mesg_nums, const size_t count);
+
+  // skip data messages older than the timestamp (seconds since UTC 00:00 Dec 31 1989), 0 to report all again
+  void SetStartTime(const FIT_DATE_TIME start_time);
+
+  // a file that is still being written is decoded without the end when its header has no data size yet
+  void SetOpenEnded(const bool open_ended);
+  // true after the header when the decoding has no end of the file yet
+  bool IsOpenEnded() const {
+    return FIT_TRUE == state_.open_ended && 0 == state_.file_bytes_left &&
+           FIT_CONVERT_DECODE_FILE_HDR != state_.decode_state;
+  }
+  // ends an open-ended decoding once the file header has the data size, the bytes left include the file CRC
+  // that is not checked by the decoder, see FitConvert_SetFileBytesLeft
+  void SetFileBytesLeft(const uint32_t file_bytes_left);
+
+  // decode only the listed fields of the global message, the timestamp is always kept
+  // the filter is dropped by Reset(), see FitConvert_SetFieldFilter for details
+  void SetFieldFilter(const FIT_MESG_NUM mesg_num, const FIT_UINT8* field_nums, const size_t count);
+
+  // true between two messages of the data section, the state can be copied there to continue decoding later
+  bool IsAtMessageBoundary() const {
+    return FIT_CONVERT_DECODE_RECORD == state_.decode_state && state_.file_bytes_left > FIT_FILE_CRC_SIZE;
+  }
+  const FIT_CONVERT_STATE& GetState() const { return state_; }
+
+  // continue from a state copied at a message boundary, the data messages that follow it are fed to Read()
+  // the file CRC and the end of the file are not checked from there, Read() returns FIT_CONVERT_CONTINUE at the end
+  void ContinueFrom(const FIT_CONVERT_STATE& state);
+
+  // valid after Read() returned FIT_CONVERT_MESSAGE_AVAILABLE
+  FIT_MESG_NUM GetMessageNumber();
+  const FIT_UINT8* GetMessageData();
+  // fields of the message that were written to GetMessageData()
+  const FIT_FIELD_CONVERT* GetMessageFields(FIT_UINT8& count);
+  // developer fields of the message and their data, in the order of the fields
+  const FIT_DEV_FIELD_DEF* GetDevFields(FIT_UINT8& count);
+  const FIT_UINT8* GetDevData(FIT_UINT8& size);
+  // byte order of the message data, FIT_ARCH_ENDIAN_LITTLE or FIT_ARCH_ENDIAN_BIG
+  FIT_UINT8 GetMessageArch() const {
+    return state_.mesg_index < FIT_LOCAL_MESGS ? state_.convert_table[state_.mesg_index].arch : FIT_ARCH_ENDIAN_LITTLE;
+  }
+
+ private:
+  FIT_CONVERT_STATE state_{};
+};
@@ -118,11 +118,11 @@ FIT_UINT8 Fit_GetArch(void)
 
 const FIT_MESG_DEF *Fit_GetMesgDef(FIT_UINT16 global_mesg_num)
 {
-   FIT_UINT8 index;
-
-   for (index = 0; index < FIT_MESGS; index++)
+   if (global_mesg_num < FIT_MESG_DEF_INDEX_SIZE)
    {
-      if (fit_mesg_defs[index]->global_mesg_num == global_mesg_num)
+      FIT_UINT8 index = fit_mesg_def_index[global_mesg_num];
+
+      if (index < FIT_MESGS)
          return (FIT_MESG_DEF *) fit_mesg_defs[index];
    }
 
@@ -31,6 +31,285 @@
    #define state  (&state_struct)
 #endif
 
+//////////////////////////////////////////////////////////////////////////////////
+// Private Functions
+//////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////
+// Fixes up a field once all its bytes are in the local mesg buffer:
+// swaps the endianness if required and null terminates a truncated
+// multi-byte character of a string.
+// Returns FIT_FALSE if the base type of the field is unknown.
+///////////////////////////////////////////////////////////////////////
+static FIT_BOOL FitConvert_FinishField(FIT_UINT8 arch, const FIT_FIELD_CONVERT *field_convert, FIT_UINT8 *field)
+{
+   if (
+         (field_convert->base_type & FIT_BASE_TYPE_ENDIAN_FLAG) &&
+         ((arch & FIT_ARCH_ENDIAN_MASK) != (Fit_GetArch() & FIT_ARCH_ENDIAN_MASK))
+      )
+   {
+      FIT_UINT8 type_size;
+      FIT_UINT8 element_size;
+      FIT_UINT8 element;
+      FIT_UINT8 index;
+
+      index = field_convert->base_type & FIT_BASE_TYPE_NUM_MASK;
+
+      if (index >= FIT_BASE_TYPES)
+         return FIT_FALSE;
+
+      type_size = fit_base_type_sizes[index];
+      element_size = field_convert->size / type_size;
+
+      for (element = 0; element < element_size; element++)
+      {
+         for (index = 0; index < (type_size / 2); index++)
+         {
+            FIT_UINT8 tmp = field[element * type_size + index];
+            field[element * type_size + index] = field[element * type_size + type_size - 1 - index];
+            field[element * type_size + type_size - 1 - index] = tmp;
+         }
+      }
+   }
+
+   // Null terminate last character if multi-byte beyond end of field.
+   if (field_convert->base_type == FIT_BASE_TYPE_STRING)
+   {
+      FIT_UINT8 length = field_convert->size;
+      FIT_UINT8 index = 0;
+
+      while (index < length)
+      {
+         FIT_UINT8 char_size;
+         FIT_UINT8 size_mask = 0x80;
+
+         if (field[index] & size_mask)
+         {
+            char_size = 0;
+
+            while (field[index] & size_mask) // # of bytes in character = # of MSBits
+            {
+               char_size++;
+               size_mask >>= 1;
+            }
+         }
+         else
+         {
+            char_size = 1;
+         }
+
+         if ((FIT_UINT16)(index + char_size) > length)
+         {
+            while (index < length)
+            {
+               field[index++] = 0;
+            }
+            break;
+         }
+
+         index += char_size;
+      }
+   }
+
+   return FIT_TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Returns FIT_TRUE if the current local message is decoded with the
+// field filter.
+///////////////////////////////////////////////////////////////////////
+static FIT_BOOL FitConvert_IsFieldFiltered(const FIT_CONVERT_STATE *convert_state)
+{
+   return (convert_state->field_filter_mesg_num != FIT_MESG_NUM_INVALID) &&
+          (convert_state->convert_table[convert_state->mesg_index].global_mesg_num == convert_state->field_filter_mesg_num);
+}
+
+///////////////////////////////////////////////////////////////////////
+// Returns FIT_TRUE if the field of the current local message has to be
+// decoded.
+///////////////////////////////////////////////////////////////////////
+static FIT_BOOL FitConvert_IsFieldKept(const FIT_CONVERT_STATE *convert_state, FIT_UINT8 field_num)
+{
+   if (!FitConvert_IsFieldFiltered(convert_state) || (field_num == FIT_FIELD_NUM_TIMESTAMP))
+      return FIT_TRUE;
+
+   return (convert_state->field_filter[field_num / 8] & (1 << (field_num % 8))) ? FIT_TRUE : FIT_FALSE;
+}
+
+#if defined(FIT_CONVERT_TIME_RECORD)
+///////////////////////////////////////////////////////////////////////
+// Remembers the timestamp of a decoded message as the base for
+// following compressed timestamp headers.
+///////////////////////////////////////////////////////////////////////
+static void FitConvert_UpdateTimestamp(FIT_CONVERT_STATE *convert_state)
+{
+   FIT_UINT16 timestamp_offset = convert_state->timestamp_offsets[convert_state->mesg_index];
+
+   if (timestamp_offset != FIT_UINT16_INVALID)
+   {
+      if (*((FIT_UINT32 *)&convert_state->u.mesg[timestamp_offset]) != FIT_DATE_TIME_INVALID)
+      {
+         memcpy(&convert_state->timestamp, &convert_state->u.mesg[timestamp_offset], sizeof(convert_state->timestamp));
+         convert_state->last_time_offset = (FIT_UINT8)(convert_state->timestamp & FIT_HDR_TIME_OFFSET_MASK);
+      }
+   }
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// Returns FIT_TRUE if the global message is not in the message filter.
+///////////////////////////////////////////////////////////////////////
+static FIT_BOOL FitConvert_IsMesgSkipped(const FIT_CONVERT_STATE *convert_state, FIT_MESG_NUM mesg_num)
+{
+   FIT_UINT8 index;
+
+   if (convert_state->num_mesg_filter == 0)
+      return FIT_FALSE;
+
+   for (index = 0; index < convert_state->num_mesg_filter; index++)
+   {
+      if (convert_state->mesg_filter[index] == mesg_num)
+         return FIT_FALSE;
+   }
+
+   return FIT_TRUE;
+}
+
+#if defined(FIT_CONVERT_TIME_RECORD)
+///////////////////////////////////////////////////////////////////////
+// Reads the timestamp field of a whole data message that is not
+// decoded yet.
+// Returns FIT_FALSE if the message has no valid timestamp field.
+///////////////////////////////////////////////////////////////////////
+static FIT_BOOL FitConvert_ReadTimestamp(const FIT_CONVERT_STATE *convert_state, const FIT_UINT8 *mesg_data, FIT_DATE_TIME *timestamp)
+{
+   const FIT_MESG_CONVERT *mesg_convert = &convert_state->convert_table[convert_state->mesg_index];
+   const FIT_FIELD_CONVERT *field_convert;
+
+   if (convert_state->timestamp_fields[convert_state->mesg_index] == FIT_UINT8_INVALID)
+      return FIT_FALSE;
+
+   field_convert = &mesg_convert->fields[convert_state->timestamp_fields[convert_state->mesg_index]];
+
+   if (field_convert->size != sizeof(*timestamp))
+      return FIT_FALSE;
+
+   memcpy(timestamp, &mesg_data[field_convert->offset_in], sizeof(*timestamp));
+   FitConvert_FinishField(mesg_convert->arch, field_convert, (FIT_UINT8 *) timestamp);
+
+   return (*timestamp != FIT_DATE_TIME_INVALID) ? FIT_TRUE : FIT_FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////
+// Returns FIT_TRUE if a whole data message is older than start_time.
+// header is the record header byte of the message.
+///////////////////////////////////////////////////////////////////////
+static FIT_BOOL FitConvert_IsBeforeStartTime(const FIT_CONVERT_STATE *convert_state, FIT_UINT8 header, const FIT_UINT8 *mesg_data)
+{
+   FIT_DATE_TIME timestamp;
+
+   if (convert_state->start_time == 0)
+      return FIT_FALSE;
+
+   if (header & FIT_HDR_TIME_REC_BIT)
+      timestamp = convert_state->timestamp; // Already advanced by the compressed timestamp header.
+   else if (!FitConvert_ReadTimestamp(convert_state, mesg_data, &timestamp))
+      return FIT_FALSE;
+
+   return (timestamp < convert_state->start_time) ? FIT_TRUE : FIT_FALSE;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// Skips a whole data message that is not in the message filter.
+// Only the timestamp field is taken from the message, it is the base
+// for following compressed timestamp headers.
+// The caller guarantees that all message bytes are in mesg_data.
+///////////////////////////////////////////////////////////////////////
+static void FitConvert_SkipMesg(FIT_CONVERT_STATE *convert_state, const FIT_UINT8 *mesg_data, FIT_UINT32 mesg_size)
+{
+   #if defined(FIT_CONVERT_CHECK_CRC)
+      convert_state->crc = FitCRC_Update16(convert_state->crc, mesg_data, mesg_size);
+   #endif
+
+   if (convert_state->file_bytes_left > 0)
+      convert_state->file_bytes_left -= mesg_size;
+
+   convert_state->data_offset += mesg_size;
+   convert_state->decode_state = FIT_CONVERT_DECODE_RECORD;
+
+   #if defined(FIT_CONVERT_TIME_RECORD)
+      {
+         FIT_DATE_TIME timestamp;
+
+         if (FitConvert_ReadTimestamp(convert_state, mesg_data, &timestamp))
+         {
+            convert_state->timestamp = timestamp;
+            convert_state->last_time_offset = (FIT_UINT8)(convert_state->timestamp & FIT_HDR_TIME_OFFSET_MASK);
+         }
+      }
+   #endif
+}
+
+///////////////////////////////////////////////////////////////////////
+// Decodes a whole data message in one step using the field plan of
+// the local message (offset in, offset local, size per field) that was
+// built from the definition message.
+// The caller guarantees that all message bytes are in mesg_data.
+// Returns FIT_CONVERT_MESSAGE_AVAILABLE, FIT_CONVERT_ERROR or
+// FIT_CONVERT_CONTINUE when the message is not reported (unknown
+// message without developer data), matching the byte by byte path.
+///////////////////////////////////////////////////////////////////////
+static FIT_CONVERT_RETURN FitConvert_DecodeMesg(FIT_CONVERT_STATE *convert_state, const FIT_UINT8 *mesg_data, FIT_UINT32 mesg_size)
+{
+   const FIT_MESG_CONVERT *mesg_convert = &convert_state->convert_table[convert_state->mesg_index];
+   FIT_BOOL mesg_decoded = FIT_FALSE;
+
+   #if defined(FIT_CONVERT_CHECK_CRC)
+      convert_state->crc = FitCRC_Update16(convert_state->crc, mesg_data, mesg_size);
+   #endif
+
+   if (convert_state->file_bytes_left > 0)
+      convert_state->file_bytes_left -= mesg_size;
+
+   convert_state->data_offset += mesg_size;
+   convert_state->decode_state = FIT_CONVERT_DECODE_RECORD;
+
+   if ((convert_state->mesg_def != FIT_NULL) && ((mesg_convert->num_fields > 0) || FitConvert_IsFieldFiltered(convert_state)))
+   {
+      FIT_UINT8 field_index;
+
+      for (field_index = 0; field_index < mesg_convert->num_fields; field_index++)
+      {
+         const FIT_FIELD_CONVERT *field_convert = &mesg_convert->fields[field_index];
+         FIT_UINT8 *field = &convert_state->u.mesg[field_convert->offset_local];
+
+         memcpy(field, &mesg_data[field_convert->offset_in], field_convert->size);
+
+         if (!FitConvert_FinishField(mesg_convert->arch, field_convert, field))
+            return FIT_CONVERT_ERROR;
+      }
+
+      #if defined(FIT_CONVERT_TIME_RECORD)
+         FitConvert_UpdateTimestamp(convert_state);
+      #endif
+
+      mesg_decoded = FIT_TRUE;
+   }
+
+   if (convert_state->dev_data_sizes[convert_state->mesg_index] > 0)
+   {
+      memcpy(convert_state->dev_data, &mesg_data[convert_state->mesg_sizes[convert_state->mesg_index]],
+             convert_state->dev_data_sizes[convert_state->mesg_index]);
+      return FIT_CONVERT_MESSAGE_AVAILABLE;
+   }
+
+   if (mesg_decoded)
+      return FIT_CONVERT_MESSAGE_AVAILABLE;
+
+   return FIT_CONVERT_CONTINUE;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 // Public Functions
 //////////////////////////////////////////////////////////////////////////////////
@@ -42,8 +321,33 @@
    void FitConvert_Init(FIT_BOOL read_file_header)
 #endif
 {
+   FIT_UINT8 index;
+
    state->mesg_offset = 0;
    state->data_offset = 0;
+   state->field_filter_mesg_num = FIT_MESG_NUM_INVALID;
+   state->num_mesg_filter = 0;
+
+   for (index = 0; index < FIT_LOCAL_MESGS; index++)
+   {
+      state->mesg_defs[index] = (FIT_MESG_DEF *) FIT_NULL;
+      state->mesg_skipped[index] = FIT_FALSE;
+      #if defined(FIT_CONVERT_TIME_RECORD)
+         state->timestamp_offsets[index] = FIT_UINT16_INVALID;
+         state->timestamp_fields[index] = FIT_UINT8_INVALID;
+      #endif
+   }
+
+   for (index = 0; index < FIT_MAX_LOCAL_MESGS; index++)
+   {
+      state->dev_data_sizes[index] = 0;
+      state->num_dev_field_defs[index] = 0;
+   }
+
+#if defined(FIT_CONVERT_TIME_RECORD)
+   state->start_time = 0;
+#endif
+   state->open_ended = FIT_FALSE;
 
 #if defined(FIT_CONVERT_CHECK_CRC)
    state->crc = 0;
@@ -111,7 +415,8 @@
          else if (state->file_bytes_left == 0) // CRC high byte.
          {
             #if defined(FIT_CONVERT_CHECK_CRC)
-               if (state->crc != 0)
+               // The CRC of an open-ended file covers the header before the data size was written to it.
+               if ((state->crc != 0) && !state->open_ended)
                   return FIT_CONVERT_ERROR;
             #endif
 
@@ -138,6 +443,11 @@
                state->file_bytes_left |= (FIT_UINT32)*((FIT_UINT8 *) &state->u.file_hdr.data_size + 3) << 24;
                state->file_bytes_left += 2; // CRC.
 
+               if ((state->file_bytes_left == FIT_FILE_CRC_SIZE) && state->open_ended)
+                  state->file_bytes_left = 0; // Data size is not written yet, don't look for the end of the file.
+               else
+                  state->open_ended = FIT_FALSE; // The file is complete, its end and CRC are checked.
+
                #if defined(FIT_CONVERT_CHECK_FILE_HDR_DATA_TYPE)
                   if (memcmp(state->u.file_hdr.data_type, ".FIT", 4) != 0)
                      return FIT_CONVERT_DATA_TYPE_NOT_SUPPORTED;
@@ -188,6 +498,7 @@
 
                   state->mesg_sizes[state->mesg_index] = 0;
                   state->dev_data_sizes[state->mesg_index] = 0;
+                  state->num_dev_field_defs[state->mesg_index] = 0;
                   state->decode_state = FIT_CONVERT_DECODE_RESERVED1;
                }
             }
@@ -196,13 +507,25 @@
             {
                if (state->mesg_index < FIT_LOCAL_MESGS)
                {
-                  state->mesg_def = Fit_GetMesgDef(state->convert_table[state->mesg_index].global_mesg_num);
-                  Fit_InitMesg(state->mesg_def, state->u.mesg);
+                  state->mesg_def = state->mesg_defs[state->mesg_index];
+
+                  if (!FitConvert_IsFieldFiltered(state))
+                  {
+                     Fit_InitMesg(state->mesg_def, state->u.mesg);
+                  }
+                  #if defined(FIT_CONVERT_TIME_RECORD)
+                     else if (state->timestamp_offsets[state->mesg_index] != FIT_UINT16_INVALID)
+                     {
+                        // Only the kept fields are written, the timestamp must not be left from the previous message.
+                        FIT_DATE_TIME timestamp = FIT_DATE_TIME_INVALID;
+                        memcpy(&state->u.mesg[state->timestamp_offsets[state->mesg_index]], &timestamp, sizeof(timestamp));
+                     }
+                  #endif
 
                   #if defined(FIT_CONVERT_TIME_RECORD)
                      if (datum & FIT_HDR_TIME_REC_BIT)
                      {
-                        FIT_UINT16 field_offset = Fit_GetFieldOffset(state->mesg_def, FIT_FIELD_NUM_TIMESTAMP);
+                        FIT_UINT16 field_offset = state->timestamp_offsets[state->mesg_index];
 
                         if (field_offset != FIT_UINT16_INVALID)
                            memcpy(&state->u.mesg[field_offset], &state->timestamp, sizeof(state->timestamp));
@@ -217,6 +540,37 @@
             state->mesg_offset = 0; // Reset the message byte count.
             state->field_index = 0;
             state->field_offset = 0;
+
+            if (state->decode_state == FIT_CONVERT_DECODE_FIELD_DATA)
+            {
+               // Fast path: the whole message including the developer data is in the buffer (and ends before the file CRC).
+               FIT_UINT32 mesg_size = (FIT_UINT32)state->mesg_sizes[state->mesg_index] + state->dev_data_sizes[state->mesg_index];
+
+               if (((size - state->data_offset) >= mesg_size) &&
+                   ((state->file_bytes_left == 0) || (state->file_bytes_left >= (mesg_size + FIT_FILE_CRC_SIZE))))
+               {
+                  FIT_CONVERT_RETURN mesg_status;
+
+                  if (state->mesg_skipped[state->mesg_index])
+                  {
+                     FitConvert_SkipMesg(state, (const FIT_UINT8 *) data + state->data_offset, mesg_size);
+                     break;
+                  }
+
+                  #if defined(FIT_CONVERT_TIME_RECORD)
+                     if (FitConvert_IsBeforeStartTime(state, datum, (const FIT_UINT8 *) data + state->data_offset))
+                     {
+                        FitConvert_SkipMesg(state, (const FIT_UINT8 *) data + state->data_offset, mesg_size);
+                        break;
+                     }
+                  #endif
+
+                  mesg_status = FitConvert_DecodeMesg(state, (const FIT_UINT8 *) data + state->data_offset, mesg_size);
+
+                  if (mesg_status != FIT_CONVERT_CONTINUE)
+                     return mesg_status;
+               }
+            }
             break;
 
          case FIT_CONVERT_DECODE_RESERVED1:
@@ -255,6 +609,12 @@
 
                state->convert_table[state->mesg_index].num_fields = 0; // Initialize.
                state->mesg_def = Fit_GetMesgDef(state->convert_table[state->mesg_index].global_mesg_num);
+               state->mesg_defs[state->mesg_index] = state->mesg_def;
+               state->mesg_skipped[state->mesg_index] = FitConvert_IsMesgSkipped(state, state->convert_table[state->mesg_index].global_mesg_num);
+               #if defined(FIT_CONVERT_TIME_RECORD)
+                  state->timestamp_offsets[state->mesg_index] = Fit_GetFieldOffset(state->mesg_def, FIT_FIELD_NUM_TIMESTAMP);
+                  state->timestamp_fields[state->mesg_index] = FIT_UINT8_INVALID;
+               #endif
             }
 
             state->decode_state = FIT_CONVERT_DECODE_NUM_FIELD_DEFS;
@@ -288,7 +648,16 @@
 
             if (state->mesg_index < FIT_LOCAL_MESGS)
             {
-               if (state->mesg_def != FIT_NULL)
+               // Keep the cache in sync if the definition was overridden after FIT_CONVERT_MESSAGE_NUMBER_FOUND.
+               if (state->mesg_defs[state->mesg_index] != state->mesg_def)
+               {
+                  state->mesg_defs[state->mesg_index] = state->mesg_def;
+                  #if defined(FIT_CONVERT_TIME_RECORD)
+                     state->timestamp_offsets[state->mesg_index] = Fit_GetFieldOffset(state->mesg_def, FIT_FIELD_NUM_TIMESTAMP);
+                  #endif
+               }
+
+               if ((state->mesg_def != FIT_NULL) && FitConvert_IsFieldKept(state, datum))
                {
                   FIT_UINT8 local_field_index;
                   FIT_UINT16 local_field_offset = 0;
@@ -336,6 +705,11 @@
          case FIT_CONVERT_DECODE_FIELD_BASE_TYPE:
             if (state->field_num != FIT_FIELD_NUM_INVALID)
             {
+               #if defined(FIT_CONVERT_TIME_RECORD)
+                  if (state->field_num == FIT_FIELD_NUM_TIMESTAMP)
+                     state->timestamp_fields[state->mesg_index] = state->convert_table[state->mesg_index].num_fields;
+               #endif
+
                state->convert_table[state->mesg_index].fields[state->convert_table[state->mesg_index].num_fields].base_type = datum;
                state->convert_table[state->mesg_index].num_fields++;
             }
@@ -367,17 +741,28 @@
             break;
 
          case FIT_CONVERT_DECODE_DEV_FIELD_DEF:
-            // Doesn't matter yet
+            if (state->field_index < FIT_DEV_FIELDS_MAX)
+               state->dev_field_defs[state->mesg_index][state->field_index].def_num = datum;
+
             state->decode_state = FIT_CONVERT_DECODE_DEV_FIELD_SIZE;
             break;
 
          case FIT_CONVERT_DECODE_DEV_FIELD_SIZE:
-            // Just keep track of the amount of data that we need to ignore
+            if (state->field_index < FIT_DEV_FIELDS_MAX)
+               state->dev_field_defs[state->mesg_index][state->field_index].size = datum;
+
+            // Keep track of the amount of data that follows the message fields
             state->dev_data_sizes[state->mesg_index] += datum;
             state->decode_state = FIT_CONVERT_DECODE_DEV_FIELD_INDEX;
             break;
 
          case FIT_CONVERT_DECODE_DEV_FIELD_INDEX:
+            if (state->field_index < FIT_DEV_FIELDS_MAX)
+            {
+               state->dev_field_defs[state->mesg_index][state->field_index].dev_index = datum;
+               state->num_dev_field_defs[state->mesg_index] = state->field_index + 1;
+            }
+
             // Increment the number of fields that we have read
             state->field_index++;
 
@@ -416,73 +801,8 @@
 
                      if (state->field_offset >= state->convert_table[state->mesg_index].fields[state->field_index].size)
                      {
-                        if (
-                              (state->convert_table[state->mesg_index].fields[state->field_index].base_type & FIT_BASE_TYPE_ENDIAN_FLAG) &&
-                              ((state->convert_table[state->mesg_index].arch & FIT_ARCH_ENDIAN_MASK) != (Fit_GetArch() & FIT_ARCH_ENDIAN_MASK))
-                           )
-                        {
-                           FIT_UINT8 type_size;
-                           FIT_UINT8 element_size;
-                           FIT_UINT8 element;
-                           FIT_UINT8 index;
-
-                           index = state->convert_table[state->mesg_index].fields[state->field_index].base_type & FIT_BASE_TYPE_NUM_MASK;
-
-                           if (index >= FIT_BASE_TYPES)
-                              return FIT_CONVERT_ERROR;
-
-                           type_size = fit_base_type_sizes[index];
-                           element_size = state->convert_table[state->mesg_index].fields[state->field_index].size / type_size;
-
-                           for (element = 0; element < element_size; element++)
-                           {
-                              for (index = 0; index < (type_size / 2); index++)
-                              {
-                                 FIT_UINT8 tmp = field[element * type_size + index];
-                                 field[element * type_size + index] = field[element * type_size + type_size - 1 - index];
-                                 field[element * type_size + type_size - 1 - index] = tmp;
-                              }
-                           }
-                        }
-
-                        // Null terminate last character if multi-byte beyond end of field.
-                        if (state->convert_table[state->mesg_index].fields[state->field_index].base_type == FIT_BASE_TYPE_STRING)
-                        {
-                           FIT_UINT8 length = state->convert_table[state->mesg_index].fields[state->field_index].size;
-                           FIT_UINT8 index = 0;
-
-                           while (index < length)
-                           {
-                              FIT_UINT8 char_size;
-                              FIT_UINT8 size_mask = 0x80;
-
-                              if (field[index] & size_mask)
-                              {
-                                 char_size = 0;
-
-                                 while (field[index] & size_mask) // # of bytes in character = # of MSBits
-                                 {
-                                    char_size++;
-                                    size_mask >>= 1;
-                                 }
-                              }
-                              else
-                              {
-                                 char_size = 1;
-                              }
-
-                              if ((FIT_UINT16)(index + char_size) > length)
-                              {
-                                 while (index < length)
-                                 {
-                                    field[index++] = 0;
-                                 }
-                                 break;
-                              }
-
-                              index += char_size;
-                           }
-                        }
+                        if (!FitConvert_FinishField(state->convert_table[state->mesg_index].arch, &state->convert_table[state->mesg_index].fields[state->field_index], field))
+                           return FIT_CONVERT_ERROR;
 
                         state->field_offset = 0; // Reset the offset.
                         state->field_index++; // Move on to the next field.
@@ -490,22 +810,11 @@
                         if (state->field_index >= state->convert_table[state->mesg_index].num_fields)
                         {
                            #if defined(FIT_CONVERT_TIME_RECORD)
-                              {
-                                 FIT_UINT16 timestamp_offset = Fit_GetFieldOffset(state->mesg_def, FIT_FIELD_NUM_TIMESTAMP);
-
-                                 if (timestamp_offset != FIT_UINT16_INVALID)
-                                 {
-                                    if (*((FIT_UINT32 *)&state->u.mesg[timestamp_offset]) != FIT_DATE_TIME_INVALID)
-                                    {
-                                       memcpy(&state->timestamp, &state->u.mesg[timestamp_offset], sizeof(state->timestamp));
-                                       state->last_time_offset = (FIT_UINT8)(state->timestamp & FIT_HDR_TIME_OFFSET_MASK);
-                                    }
-                                 }
-                              }
+                              FitConvert_UpdateTimestamp(state);
                            #endif
 
                            state->field_index = 0;
-                           if ( state->dev_data_sizes[state->mesg_index] == 0 )
+                           if ((state->dev_data_sizes[state->mesg_index] == 0) && !state->mesg_skipped[state->mesg_index])
                            {
                               // We have successfully decoded a mesg and there is no dev data to read.
                               return FIT_CONVERT_MESSAGE_AVAILABLE;
@@ -514,16 +823,31 @@
                      }
                   }
                }
+               else if ((state->mesg_def != FIT_NULL) && (state->convert_table[state->mesg_index].num_fields == 0) &&
+                        (state->decode_state == FIT_CONVERT_DECODE_RECORD) && FitConvert_IsFieldFiltered(state) &&
+                        !state->mesg_skipped[state->mesg_index])
+               {
+                  // All fields were filtered out, the message is still reported with its timestamp.
+                  #if defined(FIT_CONVERT_TIME_RECORD)
+                     FitConvert_UpdateTimestamp(state);
+                  #endif
+
+                  return FIT_CONVERT_MESSAGE_AVAILABLE;
+               }
             }
             break;
 
          case FIT_CONVERT_DECODE_DEV_FIELD_DATA:
+            state->dev_data[state->field_offset] = datum;
             state->field_offset++;
             if (state->field_offset >= state->dev_data_sizes[state->mesg_index])
             {
                // Done Parsing Dev Field Data
                state->decode_state = FIT_CONVERT_DECODE_RECORD;
 
+               if (state->mesg_skipped[state->mesg_index])
+                  break;
+
                // We have successfully decoded a mesg and there is no dev data to read.
                return FIT_CONVERT_MESSAGE_AVAILABLE;
             }
@@ -567,6 +891,111 @@
    return state->u.mesg;
 }
 
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_SetFieldFilter(FIT_CONVERT_STATE *state, FIT_MESG_NUM mesg_num, const FIT_UINT8 *field_nums, FIT_UINT8 num_field_nums)
+#else
+   void FitConvert_SetFieldFilter(FIT_MESG_NUM mesg_num, const FIT_UINT8 *field_nums, FIT_UINT8 num_field_nums)
+#endif
+{
+   FIT_UINT8 index;
+
+   memset(state->field_filter, 0, sizeof(state->field_filter));
+   state->field_filter_mesg_num = mesg_num;
+
+   for (index = 0; index < num_field_nums; index++)
+      state->field_filter[field_nums[index] / 8] |= (FIT_UINT8)(1 << (field_nums[index] % 8));
+}
+
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   FIT_BOOL FitConvert_SetMesgFilter(FIT_CONVERT_STATE *state, const FIT_MESG_NUM *mesg_nums, FIT_UINT8 num_mesg_nums)
+#else
+   FIT_BOOL FitConvert_SetMesgFilter(const FIT_MESG_NUM *mesg_nums, FIT_UINT8 num_mesg_nums)
+#endif
+{
+   FIT_UINT8 index;
+
+   if (num_mesg_nums > FIT_MESG_FILTER_MAX)
+      return FIT_FALSE;
+
+   if (num_mesg_nums > 0)
+      memcpy(state->mesg_filter, mesg_nums, num_mesg_nums * sizeof(FIT_MESG_NUM));
+
+   state->num_mesg_filter = num_mesg_nums;
+
+   // Local messages that are already defined follow the new filter.
+   for (index = 0; index < FIT_LOCAL_MESGS; index++)
+      state->mesg_skipped[index] = FitConvert_IsMesgSkipped(state, state->convert_table[index].global_mesg_num);
+
+   return FIT_TRUE;
+}
+
+#if defined(FIT_CONVERT_TIME_RECORD)
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_SetStartTime(FIT_CONVERT_STATE *state, FIT_DATE_TIME start_time)
+#else
+   void FitConvert_SetStartTime(FIT_DATE_TIME start_time)
+#endif
+{
+   state->start_time = start_time;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_SetOpenEnded(FIT_CONVERT_STATE *state, FIT_BOOL open_ended)
+#else
+   void FitConvert_SetOpenEnded(FIT_BOOL open_ended)
+#endif
+{
+   state->open_ended = open_ended;
+}
+
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_SetFileBytesLeft(FIT_CONVERT_STATE *state, FIT_UINT32 file_bytes_left)
+#else
+   void FitConvert_SetFileBytesLeft(FIT_UINT32 file_bytes_left)
+#endif
+{
+   state->file_bytes_left = file_bytes_left;
+}
+
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   const FIT_DEV_FIELD_DEF *FitConvert_GetDevFields(FIT_CONVERT_STATE *state, FIT_UINT8 *num_fields)
+#else
+   const FIT_DEV_FIELD_DEF *FitConvert_GetDevFields(FIT_UINT8 *num_fields)
+#endif
+{
+   *num_fields = state->num_dev_field_defs[state->mesg_index];
+   return state->dev_field_defs[state->mesg_index];
+}
+
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   const FIT_UINT8 *FitConvert_GetDevData(FIT_CONVERT_STATE *state, FIT_UINT8 *size)
+#else
+   const FIT_UINT8 *FitConvert_GetDevData(FIT_UINT8 *size)
+#endif
+{
+   *size = state->dev_data_sizes[state->mesg_index];
+   return state->dev_data;
+}
+
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   const FIT_FIELD_CONVERT *FitConvert_GetMessageFields(FIT_CONVERT_STATE *state, FIT_UINT8 *num_fields)
+#else
+   const FIT_FIELD_CONVERT *FitConvert_GetMessageFields(FIT_UINT8 *num_fields)
+#endif
+{
+   *num_fields = state->convert_table[state->mesg_index].num_fields;
+   return state->convert_table[state->mesg_index].fields;
+}
+
 ///////////////////////////////////////////////////////////////////////
 #if defined(FIT_CONVERT_MULTI_THREAD)
    void FitConvert_RestoreFields(FIT_CONVERT_STATE *state, const void *mesg)
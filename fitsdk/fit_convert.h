@@ -58,6 +58,11 @@ typedef enum
    FIT_CONVERT_DECODE_DEV_FIELD_DATA
 } FIT_CONVERT_DECODE_STATE;
 
+#define FIT_FIELD_FILTER_SIZE     32 // Bit per field number 0-255.
+#define FIT_MESG_FILTER_MAX       16 // Maximum number of global messages in the message filter.
+#define FIT_DEV_FIELDS_MAX        16 // Developer field definitions kept per local message, the rest is only skipped.
+#define FIT_DEV_DATA_SIZE         255 // Developer data bytes of a message, the size of all its developer fields is 8 bit.
+
 typedef struct
 {
    FIT_UINT32 file_bytes_left;
@@ -71,7 +76,21 @@ typedef struct
       FIT_UINT8 mesg[FIT_MESG_SIZE];
    }u;
    FIT_MESG_CONVERT convert_table[FIT_LOCAL_MESGS];
+   const FIT_MESG_DEF *mesg_defs[FIT_LOCAL_MESGS]; // Resolved when the local message is defined.
+   #if defined(FIT_CONVERT_TIME_RECORD)
+      FIT_UINT16 timestamp_offsets[FIT_LOCAL_MESGS]; // Offset of the timestamp field in mesg_defs[] messages.
+   #endif
    const FIT_MESG_DEF *mesg_def;
+   FIT_MESG_NUM field_filter_mesg_num; // Global message decoded with only the fields in field_filter, FIT_MESG_NUM_INVALID for none.
+   FIT_UINT8 field_filter[FIT_FIELD_FILTER_SIZE]; // Bit per field number.
+   FIT_MESG_NUM mesg_filter[FIT_MESG_FILTER_MAX]; // Global messages to report, all if num_mesg_filter is 0.
+   FIT_UINT8 num_mesg_filter;
+   FIT_BOOL mesg_skipped[FIT_LOCAL_MESGS]; // Resolved from mesg_filter when the local message is defined.
+   #if defined(FIT_CONVERT_TIME_RECORD)
+      FIT_UINT8 timestamp_fields[FIT_LOCAL_MESGS]; // Index of the timestamp field in convert_table[], FIT_UINT8_INVALID if none.
+      FIT_DATE_TIME start_time; // Data messages with an earlier timestamp are skipped, 0 for none.
+   #endif
+   FIT_BOOL open_ended; // A zero data size in the file header is decoded without the end of the file.
    #if defined(FIT_CONVERT_CHECK_CRC)
       FIT_UINT16 crc;
    #endif
@@ -80,6 +99,9 @@ typedef struct
    FIT_UINT8 mesg_index;
    FIT_UINT16 mesg_sizes[FIT_MAX_LOCAL_MESGS];
    FIT_UINT8 dev_data_sizes[FIT_MAX_LOCAL_MESGS];
+   FIT_DEV_FIELD_DEF dev_field_defs[FIT_MAX_LOCAL_MESGS][FIT_DEV_FIELDS_MAX]; // In the order of the data.
+   FIT_UINT8 num_dev_field_defs[FIT_MAX_LOCAL_MESGS];
+   FIT_UINT8 dev_data[FIT_DEV_DATA_SIZE]; // Developer data of the last message, in the message architecture.
    FIT_UINT16 mesg_offset;
    FIT_UINT8 num_fields;
    FIT_UINT8 field_num;
@@ -195,6 +217,103 @@ typedef struct
    void FitConvert_RestoreFields(const void *mesg_data);
 #endif
 
+///////////////////////////////////////////////////////////////////////
+// Restricts decoding of global message mesg_num to the listed field
+// numbers, the timestamp field is always kept. Other fields are not
+// copied and the message buffer is not initialized with invalid
+// values, use FitConvert_GetMessageFields() to find the fields that
+// were written. Messages of that number are reported even if none
+// of their fields are kept.
+// Call after FitConvert_Init() and before the message definition is
+// decoded. Pass FIT_MESG_NUM_INVALID to decode all fields again.
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_SetFieldFilter(FIT_CONVERT_STATE *state, FIT_MESG_NUM mesg_num, const FIT_UINT8 *field_nums, FIT_UINT8 num_field_nums);
+#else
+   void FitConvert_SetFieldFilter(FIT_MESG_NUM mesg_num, const FIT_UINT8 *field_nums, FIT_UINT8 num_field_nums);
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// Reports only data messages with the listed global message numbers.
+// Other data messages are skipped by their size without decoding the
+// fields, they still update the file CRC and the timestamp used for
+// compressed timestamp headers.
+// Can be called between messages, local messages that are already
+// defined follow the new filter. Pass num_mesg_nums = 0 to report all
+// messages again, a filter with only FIT_MESG_NUM_INVALID skips all.
+// Returns FIT_FALSE if more than FIT_MESG_FILTER_MAX numbers are passed.
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   FIT_BOOL FitConvert_SetMesgFilter(FIT_CONVERT_STATE *state, const FIT_MESG_NUM *mesg_nums, FIT_UINT8 num_mesg_nums);
+#else
+   FIT_BOOL FitConvert_SetMesgFilter(const FIT_MESG_NUM *mesg_nums, FIT_UINT8 num_mesg_nums);
+#endif
+
+#if defined(FIT_CONVERT_TIME_RECORD)
+///////////////////////////////////////////////////////////////////////
+// Skips data messages with a timestamp before start_time the same way
+// as messages that are not in the message filter. Only messages that
+// are whole in the data buffer are checked, messages without a
+// timestamp are always reported. Can be called between messages,
+// pass 0 to report all messages again.
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_SetStartTime(FIT_CONVERT_STATE *state, FIT_DATE_TIME start_time);
+#else
+   void FitConvert_SetStartTime(FIT_DATE_TIME start_time);
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// A file that is still being written can have a zero data size in the
+// file header. With open_ended set such a file is decoded as a stream
+// without the end and the file CRC: FitConvert_Read() returns
+// FIT_CONVERT_CONTINUE at the end of the data and decoding continues
+// with the next data appended. The flag is cleared when the header has
+// a data size. Call after FitConvert_Init().
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_SetOpenEnded(FIT_CONVERT_STATE *state, FIT_BOOL open_ended);
+#else
+   void FitConvert_SetOpenEnded(FIT_BOOL open_ended);
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// Ends an open-ended decoding after the data size was written to the
+// file header: the bytes of the file left to read including the file
+// CRC. FitConvert_Read() returns FIT_CONVERT_END_OF_FILE after them,
+// the file CRC is not checked as it covers the header that changed.
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   void FitConvert_SetFileBytesLeft(FIT_CONVERT_STATE *state, FIT_UINT32 file_bytes_left);
+#else
+   void FitConvert_SetFileBytesLeft(FIT_UINT32 file_bytes_left);
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// Returns the developer field definitions of the decoded message and
+// its developer data. Fields follow each other in the data in the
+// order of the definitions, the data is in the message architecture.
+// Only the first FIT_DEV_FIELDS_MAX definitions are returned.
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   const FIT_DEV_FIELD_DEF *FitConvert_GetDevFields(FIT_CONVERT_STATE *state, FIT_UINT8 *num_fields);
+   const FIT_UINT8 *FitConvert_GetDevData(FIT_CONVERT_STATE *state, FIT_UINT8 *size);
+#else
+   const FIT_DEV_FIELD_DEF *FitConvert_GetDevFields(FIT_UINT8 *num_fields);
+   const FIT_UINT8 *FitConvert_GetDevData(FIT_UINT8 *size);
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// Returns the fields of the decoded message that were written to the
+// message data (field number, local offset and size).
+///////////////////////////////////////////////////////////////////////
+#if defined(FIT_CONVERT_MULTI_THREAD)
+   const FIT_FIELD_CONVERT *FitConvert_GetMessageFields(FIT_CONVERT_STATE *state, FIT_UINT8 *num_fields);
+#else
+   const FIT_FIELD_CONVERT *FitConvert_GetMessageFields(FIT_UINT8 *num_fields);
+#endif
+
 ///////////////////////////////////////////////////////////////////////
 // Restores fields that are not in decoded message from mesg_data.
 // Use when modifying an existing file.
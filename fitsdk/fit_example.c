@@ -1499,6 +1499,276 @@ const FIT_CONST_MESG_DEF_PTR fit_mesg_defs[] =
    (FIT_CONST_MESG_DEF_PTR) &hrv_mesg_def,
 };
 
+// Direct-indexed lookup of FIT_MESG by global message number, FIT_MESGS for unknown messages.
+const FIT_UINT8 fit_mesg_def_index[FIT_MESG_DEF_INDEX_SIZE] =
+{
+   FIT_MESG_FILE_ID, // 0 FIT_MESG_NUM_FILE_ID
+   FIT_MESG_CAPABILITIES, // 1 FIT_MESG_NUM_CAPABILITIES
+   FIT_MESG_DEVICE_SETTINGS, // 2 FIT_MESG_NUM_DEVICE_SETTINGS
+   FIT_MESG_USER_PROFILE, // 3 FIT_MESG_NUM_USER_PROFILE
+   FIT_MESG_HRM_PROFILE, // 4 FIT_MESG_NUM_HRM_PROFILE
+   FIT_MESG_SDM_PROFILE, // 5 FIT_MESG_NUM_SDM_PROFILE
+   FIT_MESG_BIKE_PROFILE, // 6 FIT_MESG_NUM_BIKE_PROFILE
+   FIT_MESG_ZONES_TARGET, // 7 FIT_MESG_NUM_ZONES_TARGET
+   FIT_MESG_HR_ZONE, // 8 FIT_MESG_NUM_HR_ZONE
+   FIT_MESG_POWER_ZONE, // 9 FIT_MESG_NUM_POWER_ZONE
+   FIT_MESG_MET_ZONE, // 10 FIT_MESG_NUM_MET_ZONE
+   FIT_MESGS, // 11
+   FIT_MESG_SPORT, // 12 FIT_MESG_NUM_SPORT
+   FIT_MESGS, // 13
+   FIT_MESGS, // 14
+   FIT_MESG_GOAL, // 15 FIT_MESG_NUM_GOAL
+   FIT_MESGS, // 16
+   FIT_MESGS, // 17
+   FIT_MESG_SESSION, // 18 FIT_MESG_NUM_SESSION
+   FIT_MESG_LAP, // 19 FIT_MESG_NUM_LAP
+   FIT_MESG_RECORD, // 20 FIT_MESG_NUM_RECORD
+   FIT_MESG_EVENT, // 21 FIT_MESG_NUM_EVENT
+   FIT_MESGS, // 22
+   FIT_MESG_DEVICE_INFO, // 23 FIT_MESG_NUM_DEVICE_INFO
+   FIT_MESGS, // 24
+   FIT_MESGS, // 25
+   FIT_MESG_WORKOUT, // 26 FIT_MESG_NUM_WORKOUT
+   FIT_MESG_WORKOUT_STEP, // 27 FIT_MESG_NUM_WORKOUT_STEP
+   FIT_MESG_SCHEDULE, // 28 FIT_MESG_NUM_SCHEDULE
+   FIT_MESGS, // 29
+   FIT_MESG_WEIGHT_SCALE, // 30 FIT_MESG_NUM_WEIGHT_SCALE
+   FIT_MESG_COURSE, // 31 FIT_MESG_NUM_COURSE
+   FIT_MESG_COURSE_POINT, // 32 FIT_MESG_NUM_COURSE_POINT
+   FIT_MESG_TOTALS, // 33 FIT_MESG_NUM_TOTALS
+   FIT_MESG_ACTIVITY, // 34 FIT_MESG_NUM_ACTIVITY
+   FIT_MESG_SOFTWARE, // 35 FIT_MESG_NUM_SOFTWARE
+   FIT_MESGS, // 36
+   FIT_MESG_FILE_CAPABILITIES, // 37 FIT_MESG_NUM_FILE_CAPABILITIES
+   FIT_MESG_MESG_CAPABILITIES, // 38 FIT_MESG_NUM_MESG_CAPABILITIES
+   FIT_MESG_FIELD_CAPABILITIES, // 39 FIT_MESG_NUM_FIELD_CAPABILITIES
+   FIT_MESGS, // 40
+   FIT_MESGS, // 41
+   FIT_MESGS, // 42
+   FIT_MESGS, // 43
+   FIT_MESGS, // 44
+   FIT_MESGS, // 45
+   FIT_MESGS, // 46
+   FIT_MESGS, // 47
+   FIT_MESGS, // 48
+   FIT_MESG_FILE_CREATOR, // 49 FIT_MESG_NUM_FILE_CREATOR
+   FIT_MESGS, // 50
+   FIT_MESG_BLOOD_PRESSURE, // 51 FIT_MESG_NUM_BLOOD_PRESSURE
+   FIT_MESGS, // 52
+   FIT_MESG_SPEED_ZONE, // 53 FIT_MESG_NUM_SPEED_ZONE
+   FIT_MESGS, // 54
+   FIT_MESG_MONITORING, // 55 FIT_MESG_NUM_MONITORING
+   FIT_MESGS, // 56
+   FIT_MESGS, // 57
+   FIT_MESGS, // 58
+   FIT_MESGS, // 59
+   FIT_MESGS, // 60
+   FIT_MESGS, // 61
+   FIT_MESGS, // 62
+   FIT_MESGS, // 63
+   FIT_MESGS, // 64
+   FIT_MESGS, // 65
+   FIT_MESGS, // 66
+   FIT_MESGS, // 67
+   FIT_MESGS, // 68
+   FIT_MESGS, // 69
+   FIT_MESGS, // 70
+   FIT_MESGS, // 71
+   FIT_MESG_TRAINING_FILE, // 72 FIT_MESG_NUM_TRAINING_FILE
+   FIT_MESGS, // 73
+   FIT_MESGS, // 74
+   FIT_MESGS, // 75
+   FIT_MESGS, // 76
+   FIT_MESGS, // 77
+   FIT_MESG_HRV, // 78 FIT_MESG_NUM_HRV
+   FIT_MESGS, // 79
+   FIT_MESG_ANT_RX, // 80 FIT_MESG_NUM_ANT_RX
+   FIT_MESG_ANT_TX, // 81 FIT_MESG_NUM_ANT_TX
+   FIT_MESGS, // 82
+   FIT_MESGS, // 83
+   FIT_MESGS, // 84
+   FIT_MESGS, // 85
+   FIT_MESGS, // 86
+   FIT_MESGS, // 87
+   FIT_MESGS, // 88
+   FIT_MESGS, // 89
+   FIT_MESGS, // 90
+   FIT_MESGS, // 91
+   FIT_MESGS, // 92
+   FIT_MESGS, // 93
+   FIT_MESGS, // 94
+   FIT_MESGS, // 95
+   FIT_MESGS, // 96
+   FIT_MESGS, // 97
+   FIT_MESGS, // 98
+   FIT_MESGS, // 99
+   FIT_MESGS, // 100
+   FIT_MESG_LENGTH, // 101 FIT_MESG_NUM_LENGTH
+   FIT_MESGS, // 102
+   FIT_MESG_MONITORING_INFO, // 103 FIT_MESG_NUM_MONITORING_INFO
+   FIT_MESGS, // 104
+   FIT_MESG_PAD, // 105 FIT_MESG_NUM_PAD
+   FIT_MESG_SLAVE_DEVICE, // 106 FIT_MESG_NUM_SLAVE_DEVICE
+   FIT_MESGS, // 107
+   FIT_MESGS, // 108
+   FIT_MESGS, // 109
+   FIT_MESGS, // 110
+   FIT_MESGS, // 111
+   FIT_MESGS, // 112
+   FIT_MESGS, // 113
+   FIT_MESGS, // 114
+   FIT_MESGS, // 115
+   FIT_MESGS, // 116
+   FIT_MESGS, // 117
+   FIT_MESGS, // 118
+   FIT_MESGS, // 119
+   FIT_MESGS, // 120
+   FIT_MESGS, // 121
+   FIT_MESGS, // 122
+   FIT_MESGS, // 123
+   FIT_MESGS, // 124
+   FIT_MESGS, // 125
+   FIT_MESGS, // 126
+   FIT_MESG_CONNECTIVITY, // 127 FIT_MESG_NUM_CONNECTIVITY
+   FIT_MESG_WEATHER_CONDITIONS, // 128 FIT_MESG_NUM_WEATHER_CONDITIONS
+   FIT_MESG_WEATHER_ALERT, // 129 FIT_MESG_NUM_WEATHER_ALERT
+   FIT_MESGS, // 130
+   FIT_MESG_CADENCE_ZONE, // 131 FIT_MESG_NUM_CADENCE_ZONE
+   FIT_MESG_HR, // 132 FIT_MESG_NUM_HR
+   FIT_MESGS, // 133
+   FIT_MESGS, // 134
+   FIT_MESGS, // 135
+   FIT_MESGS, // 136
+   FIT_MESGS, // 137
+   FIT_MESGS, // 138
+   FIT_MESGS, // 139
+   FIT_MESGS, // 140
+   FIT_MESGS, // 141
+   FIT_MESG_SEGMENT_LAP, // 142 FIT_MESG_NUM_SEGMENT_LAP
+   FIT_MESGS, // 143
+   FIT_MESGS, // 144
+   FIT_MESGS, // 145
+   FIT_MESGS, // 146
+   FIT_MESGS, // 147
+   FIT_MESG_SEGMENT_ID, // 148 FIT_MESG_NUM_SEGMENT_ID
+   FIT_MESG_SEGMENT_LEADERBOARD_ENTRY, // 149 FIT_MESG_NUM_SEGMENT_LEADERBOARD_ENTRY
+   FIT_MESG_SEGMENT_POINT, // 150 FIT_MESG_NUM_SEGMENT_POINT
+   FIT_MESG_SEGMENT_FILE, // 151 FIT_MESG_NUM_SEGMENT_FILE
+   FIT_MESGS, // 152
+   FIT_MESGS, // 153
+   FIT_MESGS, // 154
+   FIT_MESGS, // 155
+   FIT_MESGS, // 156
+   FIT_MESGS, // 157
+   FIT_MESG_WORKOUT_SESSION, // 158 FIT_MESG_NUM_WORKOUT_SESSION
+   FIT_MESGS, // 159
+   FIT_MESGS, // 160
+   FIT_MESGS, // 161
+   FIT_MESGS, // 162
+   FIT_MESGS, // 163
+   FIT_MESGS, // 164
+   FIT_MESGS, // 165
+   FIT_MESGS, // 166
+   FIT_MESGS, // 167
+   FIT_MESGS, // 168
+   FIT_MESGS, // 169
+   FIT_MESGS, // 170
+   FIT_MESGS, // 171
+   FIT_MESGS, // 172
+   FIT_MESGS, // 173
+   FIT_MESGS, // 174
+   FIT_MESGS, // 175
+   FIT_MESGS, // 176
+   FIT_MESG_NMEA_SENTENCE, // 177 FIT_MESG_NUM_NMEA_SENTENCE
+   FIT_MESG_AVIATION_ATTITUDE, // 178 FIT_MESG_NUM_AVIATION_ATTITUDE
+   FIT_MESGS, // 179
+   FIT_MESGS, // 180
+   FIT_MESGS, // 181
+   FIT_MESGS, // 182
+   FIT_MESGS, // 183
+   FIT_MESGS, // 184
+   FIT_MESG_VIDEO_TITLE, // 185 FIT_MESG_NUM_VIDEO_TITLE
+   FIT_MESG_VIDEO_DESCRIPTION, // 186 FIT_MESG_NUM_VIDEO_DESCRIPTION
+   FIT_MESGS, // 187
+   FIT_MESGS, // 188
+   FIT_MESGS, // 189
+   FIT_MESGS, // 190
+   FIT_MESGS, // 191
+   FIT_MESGS, // 192
+   FIT_MESGS, // 193
+   FIT_MESGS, // 194
+   FIT_MESGS, // 195
+   FIT_MESGS, // 196
+   FIT_MESGS, // 197
+   FIT_MESGS, // 198
+   FIT_MESGS, // 199
+   FIT_MESG_EXD_SCREEN_CONFIGURATION, // 200 FIT_MESG_NUM_EXD_SCREEN_CONFIGURATION
+   FIT_MESG_EXD_DATA_FIELD_CONFIGURATION, // 201 FIT_MESG_NUM_EXD_DATA_FIELD_CONFIGURATION
+   FIT_MESG_EXD_DATA_CONCEPT_CONFIGURATION, // 202 FIT_MESG_NUM_EXD_DATA_CONCEPT_CONFIGURATION
+   FIT_MESGS, // 203
+   FIT_MESGS, // 204
+   FIT_MESGS, // 205
+   FIT_MESG_FIELD_DESCRIPTION, // 206 FIT_MESG_NUM_FIELD_DESCRIPTION
+   FIT_MESG_DEVELOPER_DATA_ID, // 207 FIT_MESG_NUM_DEVELOPER_DATA_ID
+   FIT_MESGS, // 208
+   FIT_MESGS, // 209
+   FIT_MESGS, // 210
+   FIT_MESGS, // 211
+   FIT_MESGS, // 212
+   FIT_MESGS, // 213
+   FIT_MESGS, // 214
+   FIT_MESGS, // 215
+   FIT_MESGS, // 216
+   FIT_MESGS, // 217
+   FIT_MESGS, // 218
+   FIT_MESGS, // 219
+   FIT_MESGS, // 220
+   FIT_MESGS, // 221
+   FIT_MESGS, // 222
+   FIT_MESGS, // 223
+   FIT_MESGS, // 224
+   FIT_MESG_SET, // 225 FIT_MESG_NUM_SET
+   FIT_MESGS, // 226
+   FIT_MESGS, // 227
+   FIT_MESGS, // 228
+   FIT_MESGS, // 229
+   FIT_MESGS, // 230
+   FIT_MESGS, // 231
+   FIT_MESGS, // 232
+   FIT_MESGS, // 233
+   FIT_MESGS, // 234
+   FIT_MESGS, // 235
+   FIT_MESGS, // 236
+   FIT_MESGS, // 237
+   FIT_MESGS, // 238
+   FIT_MESGS, // 239
+   FIT_MESGS, // 240
+   FIT_MESGS, // 241
+   FIT_MESGS, // 242
+   FIT_MESGS, // 243
+   FIT_MESGS, // 244
+   FIT_MESGS, // 245
+   FIT_MESGS, // 246
+   FIT_MESGS, // 247
+   FIT_MESGS, // 248
+   FIT_MESGS, // 249
+   FIT_MESGS, // 250
+   FIT_MESGS, // 251
+   FIT_MESGS, // 252
+   FIT_MESGS, // 253
+   FIT_MESGS, // 254
+   FIT_MESGS, // 255
+   FIT_MESGS, // 256
+   FIT_MESGS, // 257
+   FIT_MESG_DIVE_SETTINGS, // 258 FIT_MESG_NUM_DIVE_SETTINGS
+   FIT_MESGS, // 259
+   FIT_MESGS, // 260
+   FIT_MESGS, // 261
+   FIT_MESGS, // 262
+   FIT_MESGS, // 263
+   FIT_MESG_EXERCISE_TITLE, // 264 FIT_MESG_NUM_EXERCISE_TITLE
+};
+
 ///////////////////////////////////////////////////////////////////////
 // Files
 ///////////////////////////////////////////////////////////////////////
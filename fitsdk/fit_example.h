@@ -8133,6 +8133,9 @@ typedef enum {
 typedef const FIT_MESG_DEF * FIT_CONST_MESG_DEF_PTR;
 extern const FIT_CONST_MESG_DEF_PTR fit_mesg_defs[FIT_MESGS];
 
+#define FIT_MESG_DEF_INDEX_SIZE 265 // Highest global message number in fit_mesg_defs + 1.
+extern const FIT_UINT8 fit_mesg_def_index[FIT_MESG_DEF_INDEX_SIZE];
+
 
 
 
@@ -0,0 +1,285 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#include "overlay_template.h"
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// enough for the sign, 20 digits of the integer part, the dot and 6 digits after it
+constexpr size_t kFixedPointBufferSize = 32;
+// the widest field that can be aligned
+constexpr size_t kFieldWidthMax = 64;
+
+// number / (kDividerNumerator / kDividerDenominator) as std::to_string() prints the double value (6 digits after the
+// dot), cut to kTotalSymbols characters and to kDotLimit digits after the dot, without a trailing dot.
+// the text is the same as with the floating point, the division is exact with integers and is rounded only once
+template <uint64_t kDividerNumerator, uint64_t kDividerDenominator, size_t kTotalSymbols, size_t kDotLimit>
+std::string_view NumberToStringPrecision(const int64_t number, char (&buffer)[kFixedPointBufferSize]) {
+  static_assert(kDividerNumerator > 0 && kDividerDenominator > 0, "divider has to be positive");
+  static_assert(kTotalSymbols < kFixedPointBufferSize, "the text does not fit into the buffer");
+  constexpr uint64_t kFractionScale = 1000000;
+
+  const uint64_t magnitude = number < 0 ? 0 - static_cast<uint64_t>(number) : static_cast<uint64_t>(number);
+  uint64_t integer_part = magnitude * kDividerDenominator / kDividerNumerator;
+  const uint64_t remainder = magnitude * kDividerDenominator % kDividerNumerator;
+  uint64_t fraction = (remainder * kFractionScale + kDividerNumerator / 2) / kDividerNumerator;
+  if (kFractionScale == fraction) {
+    ++integer_part;
+    fraction = 0;
+  }
+
+  char* output = buffer;
+  if (number < 0) {
+    *output++ = '-';
+  }
+  const fmt::format_int integer_text(integer_part);
+  std::memcpy(output, integer_text.data(), integer_text.size());
+  output += integer_text.size();
+  const size_t dot_position = output - buffer;
+  *output++ = '.';
+  for (uint64_t digit_scale = kFractionScale / 10; digit_scale > 0; digit_scale /= 10) {
+    *output++ = static_cast<char>('0' + fraction / digit_scale % 10);
+  }
+
+  size_t size = std::min<size_t>(output - buffer, kTotalSymbols);
+  if (dot_position < size) {
+    size = std::min(size, dot_position + kDotLimit + 1);
+  }
+  if (size > 0 && '.' == buffer[size - 1]) {
+    --size;
+  }
+  return std::string_view(buffer, size);
+}
+
+}  // namespace
+
+std::unique_ptr<OverlayTemplate> OverlayTemplate::Compile(std::string_view text) {
+  std::unique_ptr<OverlayTemplate> overlay(new OverlayTemplate());
+  size_t section_index = 0;  // operation of the open section
+  bool in_section = false;
+
+  const auto error = [&text](const size_t position, std::string_view message) {
+    SPDLOG_ERROR("template error at position {}: {}, template: '{}'", position, message, text);
+    return nullptr;
+  };
+
+  size_t position = 0;
+  while (position < text.size()) {
+    const char symbol = text[position];
+    const bool doubled = position + 1 < text.size() && text[position + 1] == symbol;
+
+    if (('{' == symbol || '}' == symbol || '[' == symbol || ']' == symbol) && doubled) {
+      overlay->AddLiteral(symbol);
+      position += 2;
+    } else if ('\\' == symbol && position + 1 < text.size() &&
+               ('n' == text[position + 1] || '\\' == text[position + 1])) {
+      overlay->AddLiteral('n' == text[position + 1] ? '\n' : '\\');
+      position += 2;
+    } else if ('{' == symbol) {
+      const size_t field_end = text.find('}', position);
+      if (std::string_view::npos == field_end) {
+        return error(position, "field is not closed");
+      }
+      const std::string_view field_text(text.substr(position + 1, field_end - position - 1));
+      const size_t format_position = field_text.find(':');
+      Operation operation;
+      operation.type = OperationType::kField;
+      if (false == FieldFromName(field_text.substr(0, format_position), operation.field)) {
+        return error(position, "unknown field");
+      }
+      if (std::string_view::npos != format_position) {
+        std::string_view format(field_text.substr(format_position + 1));
+        if (false == format.empty() && ('>' == format.front() || '<' == format.front())) {
+          operation.left_align = '<' == format.front();
+          format.remove_prefix(1);
+        }
+        size_t width = 0;
+        for (const char digit : format) {
+          if (digit < '0' || digit > '9' || (width = width * 10 + (digit - '0')) > kFieldWidthMax) {
+            return error(position, "field width is not valid");
+          }
+        }
+        if (format.empty()) {
+          return error(position, "field width is not valid");
+        }
+        operation.width = static_cast<uint8_t>(width);
+      }
+      overlay->operations_.push_back(operation);
+      if (in_section) {
+        overlay->operations_[section_index].required_mask |= DataTypeToMask(FieldDataType(operation.field));
+      }
+      position = field_end + 1;
+    } else if ('[' == symbol) {
+      if (in_section) {
+        return error(position, "sections can not be nested");
+      }
+      in_section = true;
+      section_index = overlay->operations_.size();
+      overlay->operations_.push_back({OperationType::kSection});
+      ++position;
+    } else if (']' == symbol) {
+      if (false == in_section) {
+        return error(position, "section is not opened");
+      }
+      in_section = false;
+      Operation& section = overlay->operations_[section_index];
+      section.size = static_cast<uint32_t>(overlay->operations_.size() - section_index - 1);
+      ++position;
+    } else if ('}' == symbol) {
+      return error(position, "field is not opened");
+    } else {
+      overlay->AddLiteral(symbol);
+      ++position;
+    }
+  }
+  if (in_section) {
+    return error(text.size(), "section is not closed");
+  }
+  return overlay;
+}
+
+void OverlayTemplate::Render(const Record& record, const OverlayValues& values, std::string& output) const {
+  for (size_t index = 0; index < operations_.size(); ++index) {
+    const Operation& operation = operations_[index];
+    switch (operation.type) {
+      case OperationType::kLiteral:
+        output.append(literals_, operation.offset, operation.size);
+        break;
+      case OperationType::kField:
+        RenderField(operation, record, values, output);
+        break;
+      case OperationType::kSection:
+        if ((record.Valid & operation.required_mask) != operation.required_mask) {
+          index += operation.size;
+        }
+        break;
+    }
+  }
+}
+
+bool OverlayTemplate::FieldFromName(std::string_view name, Field& field) {
+  static constexpr std::pair<std::string_view, Field> kFieldNames[] = {
+      {"distance", Field::kDistance},
+      {"speed", Field::kSpeed},
+      {"heartrate", Field::kHeartRate},
+      {"cadence", Field::kCadence},
+      {"power", Field::kPower},
+      {"temperature", Field::kTemperature},
+      {"altitude", Field::kAltitude},
+      {"ascent", Field::kAscent},
+      {"descent", Field::kDescent},
+  };
+  for (const auto& [field_name, field_value] : kFieldNames) {
+    if (field_name == name) {
+      field = field_value;
+      return true;
+    }
+  }
+  return false;
+}
+
+DataType OverlayTemplate::FieldDataType(const Field field) {
+  switch (field) {
+    case Field::kDistance:
+      return DataType::kTypeDistance;
+    case Field::kSpeed:
+      return DataType::kTypeSpeed;
+    case Field::kHeartRate:
+      return DataType::kTypeHeartRate;
+    case Field::kCadence:
+      return DataType::kTypeCadence;
+    case Field::kPower:
+      return DataType::kTypePower;
+    case Field::kTemperature:
+      return DataType::kTypeTemperature;
+    case Field::kAltitude:
+    case Field::kAscent:
+    case Field::kDescent:
+      break;
+  }
+  // altitude and the values accumulated from it
+  return DataType::kTypeAltitude;
+}
+
+void OverlayTemplate::AddLiteral(const char symbol) {
+  // adjacent symbols are one span
+  if (operations_.empty() || OperationType::kLiteral != operations_.back().type) {
+    Operation operation;
+    operation.offset = static_cast<uint32_t>(literals_.size());
+    operations_.push_back(operation);
+  }
+  literals_.push_back(symbol);
+  ++operations_.back().size;
+}
+
+void OverlayTemplate::RenderField(const Operation& operation,
+                                  const Record& record,
+                                  const OverlayValues& values,
+                                  std::string& output) const {
+  const int64_t value = record.values[static_cast<uint32_t>(FieldDataType(operation.field))];
+  char buffer[kFixedPointBufferSize];
+  std::string_view text;
+  int64_t number = value;
+  switch (operation.field) {
+    case Field::kDistance:
+      // centimeters to kilometers
+      text = NumberToStringPrecision<100000, 1, 5, 2>(value, buffer);
+      break;
+    case Field::kSpeed:
+      // millimeters per second to kilometers per hour, by 277.77 as before
+      text = NumberToStringPrecision<27777, 100, 5, 1>(value, buffer);
+      break;
+    case Field::kAltitude:
+      // meters = (value / 5) - 500
+      number = value / 5 - 500;
+      break;
+    case Field::kAscent:
+      number = values.ascent / 5 - 500;
+      break;
+    case Field::kDescent:
+      number = 500 - values.descent / 5;
+      break;
+    default:
+      break;
+  }
+  if (text.empty()) {
+    const fmt::format_int number_text(number);
+    std::memcpy(buffer, number_text.data(), number_text.size());
+    text = std::string_view(buffer, number_text.size());
+  }
+
+  const size_t padding = operation.width > text.size() ? operation.width - text.size() : 0;
+  if (false == operation.left_align) {
+    output.append(padding, ' ');
+  }
+  output.append(text);
+  if (operation.left_align) {
+    output.append(padding, ' ');
+  }
+}
@@ -0,0 +1,103 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+
+// layout of the overlay text that was written by the converter before the templates
+inline constexpr std::string_view kDefaultOverlayTemplate(
+    "[{distance:>5} km][{heartrate:>5} bpm][{cadence:>5} rpm][{power:>6} w][{ascent:>5} m][{speed:>6} km/h]"
+    "[{temperature:>4} C]");
+
+// values of a cue that are accumulated over the records, in the units of the altitude field (value / 5 - 500 m)
+struct OverlayValues {
+  int64_t ascent{0};
+  int64_t descent{0};
+};
+
+// Overlay text layout with named fields, parsed once into a flat render plan of literal spans and field operations,
+// so rendering a cue is a single pass over the plan without any parsing.
+//  {field}, {field:>N}, {field:<N} - the value right (the default) or left aligned to N characters
+//  [...] - conditional section, rendered only when all fields inside of it have values, sections are not nested
+//  {{ }} [[ ]] - literal braces and brackets, \n - new line, \\ - backslash
+// fields: distance (km), speed (km/h), heartrate (bpm), cadence (rpm), power (w), temperature (C), altitude (m),
+//  ascent and descent (m, since the start)
+class OverlayTemplate final {
+ public:
+  // returns nullptr if the template is not valid, the error is logged with its position
+  static std::unique_ptr<OverlayTemplate> Compile(std::string_view text);
+
+  // appends the text of the record to the output
+  void Render(const Record& record, const OverlayValues& values, std::string& output) const;
+
+ private:
+  enum class Field : uint8_t {
+    kDistance,
+    kSpeed,
+    kHeartRate,
+    kCadence,
+    kPower,
+    kTemperature,
+    kAltitude,
+    kAscent,
+    kDescent,
+  };
+
+  enum class OperationType : uint8_t {
+    kLiteral,
+    kField,
+    kSection,
+  };
+
+  struct Operation {
+    OperationType type{OperationType::kLiteral};
+    Field field{Field::kDistance};
+    bool left_align{false};
+    uint8_t width{0};
+    // kLiteral: span of literals_, kSection: operations of the section that follow it (offset is not used)
+    uint32_t offset{0};
+    uint32_t size{0};
+    // kSection: mask of data types the fields of the section need
+    uint32_t required_mask{0};
+  };
+
+  OverlayTemplate() = default;
+
+  static bool FieldFromName(std::string_view name, Field& field);
+  static DataType FieldDataType(const Field field);
+  void AddLiteral(const char symbol);
+  void RenderField(const Operation& operation,
+                   const Record& record,
+                   const OverlayValues& values,
+                   std::string& output) const;
+
+  std::vector<Operation> operations_;
+  std::string literals_;
+};
@@ -0,0 +1,265 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#include "parse_cache.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+
+#include "data_source.h"
+
+namespace {
+
+constexpr char kParseCacheMagic[8] = {'F', 'I', 'T', '2', 'C', 'C', 'H', '\0'};
+constexpr uint32_t kParseCacheVersion = 3;
+// every column starts at this alignment in the file, the mapping itself is page aligned
+constexpr size_t kColumnAlignment = 8;
+
+struct ParseCacheHeader {
+  char magic[sizeof(kParseCacheMagic)]{};
+  uint32_t version{0};
+  uint32_t fields_mask{0};
+  uint64_t content_size{0};
+  uint64_t content_hash{0};
+  uint64_t records_count{0};
+  uint32_t header_flags{0};
+  // developer channels described in the file and the channels with columns, the first of them
+  uint32_t developer_channels{0};
+  uint32_t developer_columns{0};
+  uint32_t reserved{0};
+};
+static_assert(sizeof(ParseCacheHeader) % kColumnAlignment == 0, "columns have to be aligned after the header");
+
+// description of a developer channel, they follow the header
+struct ParseCacheChannel {
+  char name[64]{};
+  char units[16]{};
+  double scale{1.0};
+  double offset{0.0};
+};
+static_assert(sizeof(ParseCacheChannel) % kColumnAlignment == 0, "columns have to be aligned after the channels");
+
+// presence and values of every data type
+constexpr size_t kDataColumnsCount = 2 * kDataTypeMax;
+
+size_t AlignColumn(const size_t size) {
+  return (size + kColumnAlignment - 1) / kColumnAlignment * kColumnAlignment;
+}
+
+// presence columns go first and have a bit per record, developer channels are pairs of presence and values
+size_t GetColumnSize(const size_t column_index, const size_t records_count) {
+  const bool presence = column_index < kDataColumnsCount ? column_index < kDataTypeMax
+                                                         : (column_index - kDataColumnsCount) % 2 == 0;
+  return presence ? (records_count + 63) / 64 : records_count;
+}
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+
+uint64_t RotateLeft(const uint64_t value, const int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t ReadWord(const char* data) {
+  uint64_t word;
+  std::memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+uint64_t MixWord(const uint64_t lane, const uint64_t word) {
+  return RotateLeft(lane + word * kPrime2, 31) * kPrime1;
+}
+
+}  // namespace
+
+uint64_t ParseCache::ContentHash(const std::string_view content) {
+  const char* data = content.data();
+  size_t size = content.size();
+
+  // four independent lanes keep the multipliers busy
+  uint64_t lanes[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+  for (; size >= 32; data += 32, size -= 32) {
+    lanes[0] = MixWord(lanes[0], ReadWord(data));
+    lanes[1] = MixWord(lanes[1], ReadWord(data + 8));
+    lanes[2] = MixWord(lanes[2], ReadWord(data + 16));
+    lanes[3] = MixWord(lanes[3], ReadWord(data + 24));
+  }
+  uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) +
+                  RotateLeft(lanes[3], 18) + content.size();
+  for (; size >= 8; data += 8, size -= 8) {
+    hash = RotateLeft(hash ^ MixWord(0, ReadWord(data)), 27) * kPrime1 + kPrime3;
+  }
+  for (; size > 0; ++data, --size) {
+    hash = RotateLeft(hash ^ (static_cast<uint8_t>(*data) * kPrime3), 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+std::unique_ptr<ParseCache> ParseCache::Create(const std::string& cache_dir,
+                                               const std::string& fit_file,
+                                               const uint32_t fields_mask) {
+  const auto mapped_source = DataSourceMappedFile::Create(fit_file);
+  if (nullptr == mapped_source) {
+    return nullptr;
+  }
+  const std::string_view content = mapped_source->GetContiguousData();
+  const uint64_t content_hash = ContentHash(content);
+  const std::string cache_name(fmt::format("{:016x}-{:08x}{}", content_hash, fields_mask, kParseCacheExtension));
+  return std::unique_ptr<ParseCache>(new ParseCache(
+      (std::filesystem::path(cache_dir) / cache_name).string(), content.size(), content_hash, fields_mask));
+}
+
+bool ParseCache::Load(FitResult& fit_result) const {
+  std::shared_ptr<const DataSourceMappedFile> mapped_cache = DataSourceMappedFile::Create(cache_path_);
+  if (nullptr == mapped_cache) {
+    return false;
+  }
+  const std::string_view cache_data = mapped_cache->GetContiguousData();
+
+  ParseCacheHeader header;
+  if (cache_data.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, cache_data.data(), sizeof(header));
+  if (0 != std::memcmp(header.magic, kParseCacheMagic, sizeof(kParseCacheMagic)) ||
+      header.version != kParseCacheVersion || header.fields_mask != fields_mask_ ||
+      header.content_size != content_size_ || header.content_hash != content_hash_) {
+    SPDLOG_INFO("parse cache is outdated: {}", cache_path_);
+    return false;
+  }
+  const size_t channels_size = header.developer_channels * sizeof(ParseCacheChannel);
+  if (header.developer_channels > kDeveloperChannelsMax || header.developer_columns > header.developer_channels ||
+      cache_data.size() - sizeof(header) < channels_size) {
+    SPDLOG_ERROR("parse cache is broken: {}", cache_path_);
+    return false;
+  }
+
+  fit_result.developer_channels.clear();
+  for (uint32_t channel = 0; channel < header.developer_channels; ++channel) {
+    ParseCacheChannel cache_channel;
+    std::memcpy(&cache_channel, cache_data.data() + sizeof(header) + channel * sizeof(cache_channel),
+                sizeof(cache_channel));
+    DeveloperChannel& developer_channel = fit_result.developer_channels.emplace_back();
+    developer_channel.name.assign(cache_channel.name, strnlen(cache_channel.name, sizeof(cache_channel.name)));
+    developer_channel.units.assign(cache_channel.units, strnlen(cache_channel.units, sizeof(cache_channel.units)));
+    developer_channel.scale = cache_channel.scale;
+    developer_channel.offset = cache_channel.offset;
+  }
+
+  RecordColumns& columns = fit_result.result;
+  columns.Clear();
+  columns.AddDeveloperChannels(header.developer_columns);
+  // every record takes at least a byte of a value column, a larger count comes from a broken header
+  if (header.records_count > cache_data.size()) {
+    SPDLOG_ERROR("parse cache is broken: {}", cache_path_);
+    columns.Clear();
+    fit_result.developer_channels.clear();
+    return false;
+  }
+  const size_t records_count = static_cast<size_t>(header.records_count);
+  size_t offset = sizeof(header) + channels_size;
+  size_t column_index = 0;
+  bool complete = true;
+  RecordColumns::VisitColumns(columns, [&](auto& column) {
+    using Value = typename std::decay_t<decltype(column)>::ValueType;
+    const size_t column_size = GetColumnSize(column_index++, records_count);
+    if (false == complete || offset > cache_data.size() ||
+        column_size > (cache_data.size() - offset) / sizeof(Value)) {
+      complete = false;
+      return;
+    }
+    column.Map(reinterpret_cast<const Value*>(cache_data.data() + offset), column_size);
+    offset += AlignColumn(column_size * sizeof(Value));
+  });
+  if (false == complete) {
+    SPDLOG_ERROR("parse cache is broken: {}", cache_path_);
+    columns.Clear();
+    fit_result.developer_channels.clear();
+    return false;
+  }
+
+  columns.size_ = records_count;
+  columns.storage_ = std::move(mapped_cache);
+  fit_result.header_flags = header.header_flags;
+  return true;
+}
+
+bool ParseCache::Save(const FitResult& fit_result) const {
+  // written next to the final name and renamed, so a parallel conversion never maps a partial file
+  const std::string temporary_file(cache_path_ + ".tmp" + std::to_string(std::random_device{}()));
+  try {
+    std::filesystem::create_directories(std::filesystem::path(cache_path_).parent_path());
+
+    ParseCacheHeader header;
+    std::memcpy(header.magic, kParseCacheMagic, sizeof(kParseCacheMagic));
+    header.version = kParseCacheVersion;
+    header.fields_mask = fields_mask_;
+    header.content_size = content_size_;
+    header.content_hash = content_hash_;
+    header.records_count = fit_result.result.Size();
+    header.header_flags = fit_result.header_flags;
+    header.developer_channels = static_cast<uint32_t>(fit_result.developer_channels.size());
+    header.developer_columns = static_cast<uint32_t>(fit_result.result.GetDeveloperChannelsCount());
+
+    std::ofstream output_stream(temporary_file, std::ios::out | std::ios::trunc | std::ios::binary);
+    output_stream.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    output_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& developer_channel : fit_result.developer_channels) {
+      // names and units are at most 64 and 16 characters in field descriptions
+      ParseCacheChannel cache_channel;
+      developer_channel.name.copy(cache_channel.name, sizeof(cache_channel.name));
+      developer_channel.units.copy(cache_channel.units, sizeof(cache_channel.units));
+      cache_channel.scale = developer_channel.scale;
+      cache_channel.offset = developer_channel.offset;
+      output_stream.write(reinterpret_cast<const char*>(&cache_channel), sizeof(cache_channel));
+    }
+    RecordColumns::VisitColumns(fit_result.result, [&](const auto& column) {
+      using Value = typename std::decay_t<decltype(column)>::ValueType;
+      const size_t column_bytes = column.Size() * sizeof(Value);
+      const char padding[kColumnAlignment]{};
+      output_stream.write(reinterpret_cast<const char*>(column.Data()), column_bytes);
+      output_stream.write(padding, AlignColumn(column_bytes) - column_bytes);
+    });
+    output_stream.close();
+    std::filesystem::rename(temporary_file, cache_path_);
+    return true;
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("parse cache writing error: {}, check: {}", e.what(), cache_path_);
+  }
+  std::error_code remove_error;
+  std::filesystem::remove(temporary_file, remove_error);
+  return false;
+}
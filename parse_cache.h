@@ -0,0 +1,71 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "parser.h"
+
+inline constexpr std::string_view kParseCacheExtension(".fitcache");
+// added to the fields mask of the cache when developer fields are decoded
+inline constexpr uint32_t kParseCacheDeveloperFields = 0x01u << 31;
+
+// Cache of parsing results keyed by a hash of the .fit file content and the decoded fields.
+// The cache file is the header followed by the record columns as they are in memory, so on a hit the file is mapped
+// and the columns point straight into it. Values are stored in the native byte order, the cache is local.
+class ParseCache final {
+ public:
+  // returns nullptr if the input can not be mapped to hash its content
+  static std::unique_ptr<ParseCache> Create(const std::string& cache_dir,
+                                            const std::string& fit_file,
+                                            const uint32_t fields_mask);
+
+  // <cache_dir>/<content hash>-<fields mask>.fitcache
+  const std::string& GetCachePath() const { return cache_path_; }
+
+  // fills the columns, the header flags and the developer channels of the result, false if there is no valid cache file
+  bool Load(FitResult& fit_result) const;
+  bool Save(const FitResult& fit_result) const;
+
+  // 64 bit non cryptographic hash, several times faster than the decoding
+  static uint64_t ContentHash(std::string_view content);
+
+ private:
+  ParseCache(std::string cache_path,
+             const uint64_t content_size,
+             const uint64_t content_hash,
+             const uint32_t fields_mask)
+      : cache_path_(std::move(cache_path)),
+        content_size_(content_size),
+        content_hash_(content_hash),
+        fields_mask_(fields_mask) {}
+
+  std::string cache_path_;
+  uint64_t content_size_{0};
+  uint64_t content_hash_{0};
+  uint32_t fields_mask_{0};
+};
@@ -23,13 +23,23 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <array>
 #include <bitset>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <filesystem>
-#include <fstream>
-#include <iostream>
+#include <iterator>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 
-#include "fitsdk/fit_convert.h"
+#include "data_source.h"
+#include "decoder.h"
+#include "fitsdk/fit_crc.h"
+#include "parse_cache.h"
+#include "seek_index.h"
 
 namespace {
 
@@ -63,93 +73,6 @@ constexpr std::string_view kLatitudeUnitsTag("semicircles");
 constexpr std::string_view kLongitudeTag("longitude");
 constexpr std::string_view kLongitudeUnitsTag("semicircles");
 
-constexpr std::string_view kStdinTag("stdin");
-
-struct Buffer final {
- public:
-  Buffer(const size_t buffer_size) { buffer_.resize(buffer_size); }
-
-  void SetDataSize(const size_t size) { data_size_ = size; }
-
-  size_t GetDataSize() const { return data_size_; }
-
-  size_t GetBufferSize() const { return buffer_.size(); }
-
-  char* GetDataPtr() { return buffer_.data(); }
-
- private:
-  std::vector<char> buffer_;
-  size_t data_size_{0};
-};
-
-// for std::cin unique_ptr
-struct NoopDeleter final {
-  void operator()(...) const {}
-};
-
-class DataSource {
- public:
-  enum class Type {
-    kFile,
-    kStdin,
-  };
-
-  enum class Status {
-    kContinueRead,
-    kEndOfFile,
-    kError,
-  };
-
-  DataSource(Type type) : type_(type) {}
-
-  virtual ~DataSource() = default;
-
-  virtual Status ReadData(Buffer& buffer) = 0;
-
- protected:
-  Status ReadDataInternal(std::istream& stream, Buffer& buffer) {
-    try {
-      stream.read(buffer.GetDataPtr(), buffer.GetBufferSize());
-      buffer.SetDataSize(stream.gcount());
-      if (stream.eof()) {
-        return Status::kEndOfFile;
-      } else if (stream.good()) {
-        return Status::kContinueRead;
-      }
-    } catch (const std::exception& e) {
-      SPDLOG_ERROR("input file reading error: {}", e.what());  //
-    }
-    return Status::kError;
-  }
-
- private:
-  Type type_{Type::kFile};
-};
-
-
-class DataSourceFile : public DataSource {
- public:
-  DataSourceFile(std::string source_name) : DataSource(DataSource::Type::kFile), source_name_(std::move(source_name)) {
-    stream_ = std::make_unique<std::ifstream>(source_name_, std::ios::in | std::ios::app | std::ios::binary);
-    stream_->exceptions(std::ios_base::badbit);
-  }
-
-  Status ReadData(Buffer& buffer) override {
-    return ReadDataInternal(*stream_.get(), buffer);  //
-  }
-
- private:
-  std::string source_name_;
-  std::unique_ptr<std::istream> stream_;
-};
-
-class DataSourceStdin : public DataSource {
- public:
-  DataSourceStdin() : DataSource(DataSource::Type::kStdin) {}
-
-  Status ReadData(Buffer& buffer) override { return ReadDataInternal(std::cin, buffer); }
-};
-
 }  // namespace
 
 uint32_t DataTypeToMask(const DataType type) {
@@ -221,113 +144,993 @@ void ApplyValue(Record& new_record, const DataType data_type, const int64_t valu
   new_record.Valid |= DataTypeToMask(data_type);
 }
 
-std::unique_ptr<FitResult> FitParser(std::string input_fit_file) {
-  auto fit_result = std::make_unique<FitResult>();
-  uint32_t used_data_types{0};  // mask of values DataType values: 0x01 << DataType
-  uint64_t data_source_size{0};
-  try {
-    FIT_CONVERT_RETURN fit_status = FIT_CONVERT_CONTINUE;
-    FitConvert_Init(FIT_TRUE);
+namespace {
 
-    Buffer data_buffer(4096);
-    std::unique_ptr<DataSource> data_source;
-    if (kStdinTag == input_fit_file) {
-      data_source = std::make_unique<DataSourceStdin>();
-    } else {
-      data_source = std::make_unique<DataSourceFile>(input_fit_file);
-      data_source_size = std::filesystem::file_size(input_fit_file);
-      fit_result->result.reserve(data_source_size / 60);  // empirical number of bytes per record on average
+// where a field of the record message goes in Record, the width and signedness are the ones of FIT_RECORD_MESG
+struct RecordField {
+  FIT_UINT8 field_num;
+  DataType data_type;
+  FIT_UINT8 size;
+  bool is_signed;
+  bool preferred;  // enhanced fields win over the legacy ones mapped to the same slot
+};
+
+constexpr RecordField kRecordFields[] = {
+    {FIT_RECORD_FIELD_NUM_POSITION_LAT, DataType::kTypeLatitude, sizeof(FIT_SINT32), true, false},
+    {FIT_RECORD_FIELD_NUM_POSITION_LONG, DataType::kTypeLongitude, sizeof(FIT_SINT32), true, false},
+    {FIT_RECORD_FIELD_NUM_ALTITUDE, DataType::kTypeAltitude, sizeof(FIT_UINT16), false, false},
+    {FIT_RECORD_FIELD_NUM_ENHANCED_ALTITUDE, DataType::kTypeAltitude, sizeof(FIT_UINT32), false, true},
+    {FIT_RECORD_FIELD_NUM_HEART_RATE, DataType::kTypeHeartRate, sizeof(FIT_UINT8), false, false},
+    {FIT_RECORD_FIELD_NUM_CADENCE, DataType::kTypeCadence, sizeof(FIT_UINT8), false, false},
+    {FIT_RECORD_FIELD_NUM_DISTANCE, DataType::kTypeDistance, sizeof(FIT_UINT32), false, false},
+    {FIT_RECORD_FIELD_NUM_SPEED, DataType::kTypeSpeed, sizeof(FIT_UINT16), false, false},
+    {FIT_RECORD_FIELD_NUM_ENHANCED_SPEED, DataType::kTypeSpeed, sizeof(FIT_UINT32), false, true},
+    {FIT_RECORD_FIELD_NUM_POWER, DataType::kTypePower, sizeof(FIT_UINT16), false, false},
+    {FIT_RECORD_FIELD_NUM_TEMPERATURE, DataType::kTypeTemperature, sizeof(FIT_SINT8), true, false},
+};
+
+// field number -> Record slot table for the requested data types, applied to the fields the decoder wrote
+// the timestamp is not in the table, the decoder always keeps it (including compressed timestamps)
+class RecordScatter final {
+ public:
+  explicit RecordScatter(const uint32_t fields_mask) : fields_mask_(fields_mask) {
+    // position is valid only as a pair, so both fields are decoded if any of them is requested
+    decode_mask_ = (fields_mask & kPositionMask) != 0 ? fields_mask | kPositionMask : fields_mask;
+    fields_.fill(nullptr);
+    for (const auto& record_field : kRecordFields) {
+      if ((decode_mask_ & DataTypeToMask(record_field.data_type)) != 0) {
+        fields_[record_field.field_num] = &record_field;
+        field_nums_.push_back(record_field.field_num);
+      }
     }
+  }
 
-    while ((DataSource::Status::kError != data_source->ReadData(data_buffer)) && (fit_status == FIT_CONVERT_CONTINUE)) {
-      while (fit_status = FitConvert_Read(data_buffer.GetDataPtr(), static_cast<FIT_UINT32>(data_buffer.GetDataSize())),
-             fit_status == FIT_CONVERT_MESSAGE_AVAILABLE) {
-        if (FitConvert_GetMessageNumber() != FIT_MESG_NUM_RECORD) {
-          continue;
-        }
+  const std::vector<FIT_UINT8>& GetFieldNumbers() const { return field_nums_; }
+  // data types the decoder is asked for
+  uint32_t GetDecodeMask() const { return decode_mask_; }
+
+  void Apply(const FIT_FIELD_CONVERT* fields, const FIT_UINT8 count, const FIT_UINT8* mesg, Record& record) const {
+    uint32_t preferred_mask{0};
+    for (FIT_UINT8 index = 0; index < count; ++index) {
+      const RecordField* record_field = fields_[fields[index].num];
+      // truncated fields are not complete values
+      if (nullptr == record_field || fields[index].size != record_field->size) {
+        continue;
+      }
+      const uint32_t type_mask = DataTypeToMask(record_field->data_type);
+      if (false == record_field->preferred && (preferred_mask & type_mask) != 0) {
+        continue;
+      }
 
-        const FIT_UINT8* fit_message_ptr = FitConvert_GetMessageData();
-        const FIT_RECORD_MESG* fit_record_ptr = reinterpret_cast<const FIT_RECORD_MESG*>(fit_message_ptr);
+      int64_t value{0};
+      if (false == ReadValue(*record_field, mesg + fields[index].offset_local, value)) {
+        continue;
+      }
+      ApplyValue(record, record_field->data_type, value);
+      if (record_field->preferred) {
+        preferred_mask |= type_mask;
+      }
+    }
 
-        // allocate struct
-        fit_result->result.emplace_back();
-        // convert timestamp to milliseconds
-        const int64_t type_msec = static_cast<int64_t>(fit_record_ptr->timestamp) * 1000;
-        ApplyValue(fit_result->result.back(), DataType::kTypeTimeStamp, type_msec);
+    // position is valid only as a pair, the other half of the pair may be decoded just for this check
+    const bool position_valid = (record.Valid & kPositionMask) == kPositionMask;
+    for (const DataType position_type : {DataType::kTypeLatitude, DataType::kTypeLongitude}) {
+      if (false == position_valid || (fields_mask_ & DataTypeToMask(position_type)) == 0) {
+        record.Valid &= ~DataTypeToMask(position_type);
+        record.values[static_cast<uint32_t>(position_type)] = 0;
+      }
+    }
+  }
 
-        std::string output;
-        if (fit_record_ptr->distance != FIT_UINT32_INVALID) {
-          // FIT_UINT32 distance = 100 * m = cm
-          ApplyValue(fit_result->result.back(), DataType::kTypeDistance, fit_record_ptr->distance);
+ private:
+  // returns false for the invalid value of the field type
+  static bool ReadValue(const RecordField& record_field, const FIT_UINT8* data, int64_t& value) {
+    switch (record_field.size) {
+      case sizeof(FIT_UINT8): {
+        FIT_UINT8 raw;
+        std::memcpy(&raw, data, sizeof(raw));
+        if (record_field.is_signed) {
+          value = static_cast<FIT_SINT8>(raw);
+          return raw != static_cast<FIT_UINT8>(FIT_SINT8_INVALID);
         }
-
-        if (fit_record_ptr->heart_rate != FIT_BYTE_INVALID) {
-          // FIT_UINT8 heart_rate = bpm
-          ApplyValue(fit_result->result.back(), DataType::kTypeHeartRate, fit_record_ptr->heart_rate);
+        value = raw;
+        return raw != FIT_UINT8_INVALID;
+      }
+      case sizeof(FIT_UINT16): {
+        FIT_UINT16 raw;
+        std::memcpy(&raw, data, sizeof(raw));
+        if (record_field.is_signed) {
+          value = static_cast<FIT_SINT16>(raw);
+          return raw != static_cast<FIT_UINT16>(FIT_SINT16_INVALID);
         }
-
-        if (fit_record_ptr->cadence != FIT_BYTE_INVALID) {
-          // FIT_UINT8 cadence = rpm
-          ApplyValue(fit_result->result.back(), DataType::kTypeCadence, fit_record_ptr->cadence);
+        value = raw;
+        return raw != FIT_UINT16_INVALID;
+      }
+      case sizeof(FIT_UINT32): {
+        FIT_UINT32 raw;
+        std::memcpy(&raw, data, sizeof(raw));
+        if (record_field.is_signed) {
+          value = static_cast<FIT_SINT32>(raw);
+          return raw != static_cast<FIT_UINT32>(FIT_SINT32_INVALID);
         }
+        value = raw;
+        return raw != FIT_UINT32_INVALID;
+      }
+    }
+    return false;
+  }
 
-        if (fit_record_ptr->power != FIT_UINT16_INVALID) {
-          // FIT_UINT16 power = watts
-          ApplyValue(fit_result->result.back(), DataType::kTypePower, fit_record_ptr->power);
-        }
+  static constexpr uint32_t kPositionMask = (0x01 << static_cast<uint32_t>(DataType::kTypeLatitude)) |
+                                            (0x01 << static_cast<uint32_t>(DataType::kTypeLongitude));
 
-        if (fit_record_ptr->altitude != FIT_UINT16_INVALID) {
-          // FIT_UINT16 altitude = 5 * m + 500
-          ApplyValue(fit_result->result.back(), DataType::kTypeAltitude, fit_record_ptr->altitude);
-        }
+  uint32_t fields_mask_;
+  uint32_t decode_mask_;
+  std::array<const RecordField*, 256> fields_;
+  std::vector<FIT_UINT8> field_nums_;
+};
 
-        if (fit_record_ptr->enhanced_altitude != FIT_UINT32_INVALID) {
-          // FIT_UINT32 enhanced_altitude = 5 * m + 500
-          ApplyValue(fit_result->result.back(), DataType::kTypeAltitude, fit_record_ptr->enhanced_altitude);
-        }
+// developer fields of record messages resolved once from their field_description messages into channels, values are
+// scattered into the channels by (developer data index, field number) without any name lookups
+class DeveloperFieldTable final {
+ public:
+  explicit DeveloperFieldTable(const DeveloperChannelCallback& channel_callback)
+      : channel_callback_(channel_callback) {}
 
-        if (fit_record_ptr->speed != FIT_UINT16_INVALID) {
-          // FIT_UINT16 speed = 1000 * m/s = mm/s
-          ApplyValue(fit_result->result.back(), DataType::kTypeSpeed, fit_record_ptr->speed);
-        }
+  // descriptions for other messages, of unsupported types or over kDeveloperChannelsMax are ignored
+  void AddDescription(const FIT_FIELD_DESCRIPTION_MESG& description) {
+    if (description.native_mesg_num != FIT_MESG_NUM_RECORD && description.native_mesg_num != FIT_MESG_NUM_INVALID) {
+      return;
+    }
+    const FIT_UINT8 value_size = GetValueSize(description.fit_base_type_id);
+    if (0 == value_size) {
+      return;
+    }
+    if (description.developer_data_index >= fields_.size()) {
+      fields_.resize(description.developer_data_index + 1);
+    }
+    Field& field = fields_[description.developer_data_index][description.field_definition_number];
+    const Field previous_field = field;
+    if (kNoChannel == field.channel) {
+      if (channels_.size() >= kDeveloperChannelsMax) {
+        return;
+      }
+      field.channel = static_cast<uint8_t>(channels_.size());
+      channels_.emplace_back();
+    }
+    field.base_type = description.fit_base_type_id;
+    field.size = value_size;
+
+    std::string name(description.field_name, strnlen(description.field_name, sizeof(description.field_name)));
+    if (name.empty()) {
+      name = "developer_" + std::to_string(field.channel);
+    }
+    DeveloperChannel& channel = channels_[field.channel];
+    const DeveloperChannel previous_channel = channel;
+    channel.name = MakeUniqueName(field.channel, name);
+    channel.units.assign(description.units, strnlen(description.units, sizeof(description.units)));
+    if (IsFloat(field.base_type)) {
+      channel.scale = DeveloperChannel::kFloatScale;
+    } else {
+      const bool scale_valid = description.scale != FIT_UINT8_INVALID && description.scale != 0;
+      channel.scale = scale_valid ? description.scale : 1.0;
+    }
+    channel.offset = description.offset != FIT_SINT8_INVALID ? description.offset : 0.0;
+    // records before and after a changed description are decoded differently
+    if (kNoChannel != previous_field.channel &&
+        (previous_field.base_type != field.base_type || previous_channel.name != channel.name ||
+         previous_channel.units != channel.units || previous_channel.scale != channel.scale ||
+         previous_channel.offset != channel.offset)) {
+      redescribed_ = true;
+    }
+    if (channel_callback_) {
+      channel_callback_(field.channel, channel);
+    }
+  }
+
+  void Apply(FitDecoder& fit_decoder, Record& record) const {
+    FIT_UINT8 fields_count{0};
+    const FIT_DEV_FIELD_DEF* dev_fields = fit_decoder.GetDevFields(fields_count);
+    if (0 == fields_count || fields_.empty()) {
+      return;
+    }
+    FIT_UINT8 data_size{0};
+    const FIT_UINT8* data = fit_decoder.GetDevData(data_size);
+    const bool big_endian = (fit_decoder.GetMessageArch() & FIT_ARCH_ENDIAN_MASK) == FIT_ARCH_ENDIAN_BIG;
+
+    size_t offset = 0;
+    for (FIT_UINT8 index = 0; index < fields_count; offset += dev_fields[index].size, ++index) {
+      const FIT_DEV_FIELD_DEF& dev_field = dev_fields[index];
+      if (dev_field.dev_index >= fields_.size() || offset + dev_field.size > data_size) {
+        continue;
+      }
+      const Field& field = fields_[dev_field.dev_index][dev_field.def_num];
+      // arrays are not decoded
+      if (kNoChannel == field.channel || dev_field.size != field.size) {
+        continue;
+      }
+      int64_t value{0};
+      if (ReadValue(field.base_type, data + offset, field.size, big_endian, value)) {
+        record.developer_values[field.channel] = value;
+        record.developer_valid |= 0x01 << field.channel;
+      }
+    }
+  }
+
+  const std::vector<DeveloperChannel>& GetChannels() const { return channels_; }
+
+  // some field was described again with another type, name or scale
+  bool IsRedescribed() const { return redescribed_; }
+
+  void Clear() {
+    fields_.clear();
+    channels_.clear();
+    redescribed_ = false;
+  }
+
+ private:
+  static constexpr uint8_t kNoChannel = 0xFF;
+
+  struct Field {
+    uint8_t channel{kNoChannel};
+    uint8_t base_type{0};
+    uint8_t size{0};
+  };
+
+  static bool IsFloat(const FIT_UINT8 base_type) {
+    return FIT_BASE_TYPE_FLOAT32 == base_type || FIT_BASE_TYPE_FLOAT64 == base_type;
+  }
+
+  // size of a single value of the base type, 0 for the types that are not decoded (strings and bytes)
+  static FIT_UINT8 GetValueSize(const FIT_UINT8 base_type) {
+    switch (base_type) {
+      case FIT_BASE_TYPE_ENUM:
+      case FIT_BASE_TYPE_SINT8:
+      case FIT_BASE_TYPE_UINT8:
+      case FIT_BASE_TYPE_UINT8Z:
+        return 1;
+      case FIT_BASE_TYPE_SINT16:
+      case FIT_BASE_TYPE_UINT16:
+      case FIT_BASE_TYPE_UINT16Z:
+        return 2;
+      case FIT_BASE_TYPE_SINT32:
+      case FIT_BASE_TYPE_UINT32:
+      case FIT_BASE_TYPE_UINT32Z:
+      case FIT_BASE_TYPE_FLOAT32:
+        return 4;
+      case FIT_BASE_TYPE_SINT64:
+      case FIT_BASE_TYPE_UINT64:
+      case FIT_BASE_TYPE_UINT64Z:
+      case FIT_BASE_TYPE_FLOAT64:
+        return 8;
+    }
+    return 0;
+  }
+
+  // floating point values are kept as fixed point, the values that do not fit are invalid
+  static bool ReadFloat(const double float_value, int64_t& value) {
+    constexpr double kFloatLimit = 1e15;
+    const double scaled = float_value * DeveloperChannel::kFloatScale;
+    if (false == std::isfinite(scaled) || std::fabs(scaled) > kFloatLimit) {
+      return false;
+    }
+    value = std::llround(scaled);
+    return true;
+  }
+
+  // returns false for the invalid value of the base type
+  static bool ReadValue(const FIT_UINT8 base_type,
+                        const FIT_UINT8* data,
+                        const FIT_UINT8 size,
+                        const bool big_endian,
+                        int64_t& value) {
+    uint64_t raw{0};
+    for (FIT_UINT8 index = 0; index < size; ++index) {
+      const FIT_UINT8 byte = data[big_endian ? index : size - 1 - index];
+      raw = (raw << 8) | byte;
+    }
+    const uint64_t all_bits = size < 8 ? (uint64_t{1} << (size * 8)) - 1 : ~uint64_t{0};
+    const uint64_t signed_invalid = all_bits >> 1;
+    switch (base_type) {
+      case FIT_BASE_TYPE_SINT8:
+      case FIT_BASE_TYPE_SINT16:
+      case FIT_BASE_TYPE_SINT32:
+      case FIT_BASE_TYPE_SINT64: {
+        // sign extension of the value to 64 bits
+        const uint64_t sign_bit = uint64_t{1} << (size * 8 - 1);
+        value = static_cast<int64_t>((raw ^ sign_bit) - sign_bit);
+        return raw != signed_invalid;
+      }
+      case FIT_BASE_TYPE_UINT8Z:
+      case FIT_BASE_TYPE_UINT16Z:
+      case FIT_BASE_TYPE_UINT32Z:
+      case FIT_BASE_TYPE_UINT64Z:
+        value = static_cast<int64_t>(raw);
+        return raw != 0;
+      case FIT_BASE_TYPE_FLOAT32: {
+        FIT_FLOAT32 float_value;
+        const uint32_t float_bits = static_cast<uint32_t>(raw);
+        std::memcpy(&float_value, &float_bits, sizeof(float_value));
+        return raw != all_bits && ReadFloat(float_value, value);
+      }
+      case FIT_BASE_TYPE_FLOAT64: {
+        FIT_FLOAT64 float_value;
+        std::memcpy(&float_value, &raw, sizeof(float_value));
+        return raw != all_bits && ReadFloat(float_value, value);
+      }
+    }
+    value = static_cast<int64_t>(raw);
+    return raw != all_bits;
+  }
+
+  // names are keys next to the data type names in the json records, a taken name gets a numbered suffix
+  std::string MakeUniqueName(const uint8_t channel, const std::string& name) const {
+    std::string unique_name(name);
+    for (size_t suffix = 2; IsNameTaken(channel, unique_name); ++suffix) {
+      unique_name = name + "_" + std::to_string(suffix);
+    }
+    return unique_name;
+  }
+
+  bool IsNameTaken(const uint8_t channel, const std::string& name) const {
+    DataType data_type;
+    if (DataTypeFromName(name, data_type)) {
+      return true;
+    }
+    for (size_t index = 0; index < channels_.size(); ++index) {
+      if (index != channel && channels_[index].name == name) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // by developer data index, then by field number
+  std::vector<std::array<Field, 256>> fields_;
+  std::vector<DeveloperChannel> channels_;
+  bool redescribed_{false};
+  const DeveloperChannelCallback& channel_callback_;
+};
+
+}  // namespace
+
+bool DataTypeFromName(std::string_view name, DataType& type) {
+  for (uint32_t index = kDataTypeFirst; index < kDataTypeMax; ++index) {
+    if (DataTypeToName(static_cast<DataType>(index)) == name) {
+      type = static_cast<DataType>(index);
+      return true;
+    }
+  }
+  return false;
+}
+
+void RecordColumns::Reserve(const size_t records_count) {
+  const size_t presence_words = (records_count + 63) / 64;
+  for (auto& presence : presence_) {
+    presence.Reserve(presence_words);
+  }
+  timestamps_.Reserve(records_count);
+  speed_.Reserve(records_count);
+  distance_.Reserve(records_count);
+  heart_rate_.Reserve(records_count);
+  altitude_.Reserve(records_count);
+  power_.Reserve(records_count);
+  cadence_.Reserve(records_count);
+  temperature_.Reserve(records_count);
+  latitude_.Reserve(records_count);
+  longitude_.Reserve(records_count);
+}
+
+void RecordColumns::Clear() {
+  size_ = 0;
+  for (auto& presence : presence_) {
+    presence.Clear();
+  }
+  timestamps_.Clear();
+  speed_.Clear();
+  distance_.Clear();
+  heart_rate_.Clear();
+  altitude_.Clear();
+  power_.Clear();
+  cadence_.Clear();
+  temperature_.Clear();
+  latitude_.Clear();
+  longitude_.Clear();
+  developer_presence_.clear();
+  developer_values_.clear();
+  storage_.reset();
+}
+
+void RecordColumns::Append(const Record& record) {
+  if (0 == (size_ % 64)) {
+    for (auto& presence : presence_) {
+      presence.PushBack(0);
+    }
+  }
+  const uint64_t presence_bit = uint64_t{1} << (size_ % 64);
+  for (uint32_t index = kDataTypeFirst; index < kDataTypeMax; ++index) {
+    if ((record.Valid & DataTypeToMask(static_cast<DataType>(index))) != 0) {
+      presence_[index].Back() |= presence_bit;
+    }
+  }
+
+  const auto value = [&record](const DataType type) { return record.values[static_cast<uint32_t>(type)]; };
+  // values of missing channels are zero in the record, so the columns stay dense
+  timestamps_.PushBack(static_cast<uint32_t>(value(DataType::kTypeTimeStamp) / 1000));
+  speed_.PushBack(static_cast<uint32_t>(value(DataType::kTypeSpeed)));
+  distance_.PushBack(static_cast<uint32_t>(value(DataType::kTypeDistance)));
+  heart_rate_.PushBack(static_cast<uint8_t>(value(DataType::kTypeHeartRate)));
+  altitude_.PushBack(static_cast<uint32_t>(value(DataType::kTypeAltitude)));
+  power_.PushBack(static_cast<uint16_t>(value(DataType::kTypePower)));
+  cadence_.PushBack(static_cast<uint8_t>(value(DataType::kTypeCadence)));
+  temperature_.PushBack(static_cast<int8_t>(value(DataType::kTypeTemperature)));
+  latitude_.PushBack(static_cast<int32_t>(value(DataType::kTypeLatitude)));
+  longitude_.PushBack(static_cast<int32_t>(value(DataType::kTypeLongitude)));
+
+  // up to the highest channel with a value, the channels are numbered in the order of their descriptions
+  size_t channels_count = 0;
+  for (uint32_t valid = record.developer_valid; 0 != valid; valid >>= 1) {
+    ++channels_count;
+  }
+  AddDeveloperChannels(channels_count);
+  for (size_t channel = 0; channel < developer_values_.size(); ++channel) {
+    if (0 == (size_ % 64)) {
+      developer_presence_[channel].PushBack(0);
+    }
+    if ((record.developer_valid & (0x01 << channel)) != 0) {
+      developer_presence_[channel].Back() |= presence_bit;
+    }
+    developer_values_[channel].PushBack(record.developer_values[channel]);
+  }
+  ++size_;
+}
+
+void RecordColumns::AddDeveloperChannels(const size_t channels_count) {
+  // new channels are filled up to the current size, the records before had no values there
+  while (developer_values_.size() < channels_count) {
+    developer_presence_.emplace_back();
+    developer_values_.emplace_back();
+    for (size_t word = 0; word < (size_ + 63) / 64; ++word) {
+      developer_presence_.back().PushBack(0);
+    }
+    for (size_t index = 0; index < size_; ++index) {
+      developer_values_.back().PushBack(0);
+    }
+  }
+}
+
+int64_t RecordColumns::GetValue(const size_t index, const DataType type) const {
+  switch (type) {
+    case DataType::kTypeSpeed:
+      return speed_[index];
+    case DataType::kTypeDistance:
+      return distance_[index];
+    case DataType::kTypeHeartRate:
+      return heart_rate_[index];
+    case DataType::kTypeAltitude:
+      return altitude_[index];
+    case DataType::kTypePower:
+      return power_[index];
+    case DataType::kTypeCadence:
+      return cadence_[index];
+    case DataType::kTypeTemperature:
+      return temperature_[index];
+    case DataType::kTypeTimeStamp:
+      // milliseconds, the same as in Record
+      return static_cast<int64_t>(timestamps_[index]) * 1000;
+    case DataType::kTypeLatitude:
+      return latitude_[index];
+    case DataType::kTypeLongitude:
+      return longitude_[index];
+    case DataType::kTypeMax:
+      break;
+  }
+  return 0;
+}
+
+Record RecordColumns::GetRecord(const size_t index) const {
+  Record record;
+  for (uint32_t type_index = kDataTypeFirst; type_index < kDataTypeMax; ++type_index) {
+    const DataType type = static_cast<DataType>(type_index);
+    if (IsValid(index, type)) {
+      ApplyValue(record, type, GetValue(index, type));
+    }
+  }
+  for (uint32_t channel = 0; channel < developer_values_.size(); ++channel) {
+    if (IsDeveloperValid(index, channel)) {
+      record.developer_values[channel] = developer_values_[channel][index];
+      record.developer_valid |= 0x01 << channel;
+    }
+  }
+  return record;
+}
+
+namespace {
+
+// smaller files are decoded faster than the threads are started
+constexpr size_t kParallelDecodeMinSize = 4 * 1024 * 1024;
+// size of the ranges decoded on their own, it bounds the records kept in memory per range
+constexpr size_t kDecodeRangeSize = 512 * 1024;
+// ranges per decoding thread that are decoded ahead of the emitted one
+constexpr size_t kRangesAheadPerThread = 2;
+// empirical number of bytes per record on average
+constexpr size_t kBytesPerRecord = 60;
+
+const FIT_MESG_NUM kRecordMesgNum = FIT_MESG_NUM_RECORD;
+const FIT_MESG_NUM kSkipAllMesgNum = FIT_MESG_NUM_INVALID;
+const FIT_MESG_NUM kDescriptionMesgNum = FIT_MESG_NUM_FIELD_DESCRIPTION;
+const FIT_MESG_NUM kRecordDescriptionMesgNums[] = {FIT_MESG_NUM_RECORD, FIT_MESG_NUM_FIELD_DESCRIPTION};
+
+// other messages are skipped without decoding, record messages are decoded with the projected fields only
+// field descriptions are decoded too when there is a table for the developer fields
+void SetupRecordDecoder(FitDecoder& fit_decoder,
+                        const RecordScatter& record_scatter,
+                        const DeveloperFieldTable* developer_table) {
+  if (nullptr != developer_table) {
+    fit_decoder.SetMessageFilter(kRecordDescriptionMesgNums, std::size(kRecordDescriptionMesgNums));
+  } else {
+    fit_decoder.SetMessageFilter(&kRecordMesgNum, 1);
+  }
+  fit_decoder.SetFieldFilter(
+      FIT_MESG_NUM_RECORD, record_scatter.GetFieldNumbers().data(), record_scatter.GetFieldNumbers().size());
+}
+
+// header items in the output order for the data types in FitResult::header_flags
+void SetHeader(FitResult& fit_result) {
+  fit_result.header.clear();
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypeAltitude);
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypeCadence);
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypeDistance);
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypeHeartRate);
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypeLatitude);
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypeLongitude);
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypePower);
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypeSpeed);
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypeTemperature);
+  HeaderItem(fit_result.header, fit_result.header_flags, DataType::kTypeTimeStamp);
+}
+
+// the parse cache is used for complete results of regular files
+bool UseParseCache(const std::string& input_fit_file, const ParseOptions& options) {
+  return false == options.cache_dir.empty() && kStdinTag != input_fit_file && false == options.HasRange() &&
+         false == options.follow;
+}
+
+// adds the description to the table when the decoder returned a field description message
+void AddFieldDescription(FitDecoder& fit_decoder, DeveloperFieldTable* developer_table) {
+  if (nullptr != developer_table && fit_decoder.GetMessageNumber() == FIT_MESG_NUM_FIELD_DESCRIPTION) {
+    developer_table->AddDescription(*reinterpret_cast<const FIT_FIELD_DESCRIPTION_MESG*>(fit_decoder.GetMessageData()));
+  }
+}
+
+// builds the record from the message returned by the decoder, false for other messages
+bool DecodeRecord(FitDecoder& fit_decoder,
+                  const RecordScatter& record_scatter,
+                  const DeveloperFieldTable* developer_table,
+                  Record& record) {
+  if (fit_decoder.GetMessageNumber() != FIT_MESG_NUM_RECORD) {
+    return false;
+  }
+
+  const FIT_UINT8* fit_message_ptr = fit_decoder.GetMessageData();
+  const FIT_RECORD_MESG* fit_record_ptr = reinterpret_cast<const FIT_RECORD_MESG*>(fit_message_ptr);
+
+  // convert timestamp to milliseconds
+  const int64_t type_msec = static_cast<int64_t>(fit_record_ptr->timestamp) * 1000;
+  ApplyValue(record, DataType::kTypeTimeStamp, type_msec);
+
+  // only the projected fields are decoded, the rest of the message data is not initialized
+  FIT_UINT8 fields_count{0};
+  const FIT_FIELD_CONVERT* fields = fit_decoder.GetMessageFields(fields_count);
+  record_scatter.Apply(fields, fields_count, fit_message_ptr, record);
+  if (nullptr != developer_table) {
+    developer_table->Apply(fit_decoder, record);
+  }
+  return true;
+}
 
-        if (fit_record_ptr->enhanced_speed != FIT_UINT32_INVALID) {
-          // FIT_UINT32 enhanced_speed = 1000 * m/s = mm/s
-          ApplyValue(fit_result->result.back(), DataType::kTypeSpeed, fit_record_ptr->enhanced_speed);
+// part of the data section that starts at a message boundary together with the decoder state there
+struct DecodeRange {
+  size_t begin{0};
+  size_t end{0};
+  FIT_CONVERT_STATE state{};
+};
+
+// first pass: only headers and definitions are decoded, data messages are skipped by their size (the file CRC is
+// still checked), the decoder state is saved at the first message boundary after every split point
+// field descriptions are collected into the developer table when there is one
+FIT_CONVERT_RETURN PrescanRanges(std::string_view data,
+                                 const RecordScatter& record_scatter,
+                                 DeveloperFieldTable* developer_table,
+                                 const size_t ranges_count,
+                                 std::vector<DecodeRange>& ranges) {
+  FitDecoder fit_decoder;
+  // definitions of the record message are built exactly as the range decoders need them
+  fit_decoder.SetMessageFilter(nullptr != developer_table ? &kDescriptionMesgNum : &kSkipAllMesgNum, 1);
+  fit_decoder.SetFieldFilter(
+      FIT_MESG_NUM_RECORD, record_scatter.GetFieldNumbers().data(), record_scatter.GetFieldNumbers().size());
+
+  size_t position = 0;
+  size_t data_end = 0;
+  FIT_CONVERT_RETURN fit_status = FIT_CONVERT_CONTINUE;
+  const auto feed = [&](const size_t size) {
+    while (fit_status = fit_decoder.Read(data.data() + position, size), fit_status == FIT_CONVERT_MESSAGE_AVAILABLE) {
+      AddFieldDescription(fit_decoder, developer_table);
+    }
+    position += size;
+    return FIT_CONVERT_CONTINUE == fit_status;
+  };
+
+  const size_t range_size = data.size() / ranges_count;
+  for (size_t split = 0; split < ranges_count; ++split) {
+    if (false == feed(std::max(split * range_size, position) - position)) {
+      break;
+    }
+    // the next message boundary is at most one message away
+    while (false == fit_decoder.IsAtMessageBoundary() && position < data.size() && feed(1)) {
+    }
+    if (FIT_CONVERT_CONTINUE != fit_status || false == fit_decoder.IsAtMessageBoundary()) {
+      break;
+    }
+    if (false == ranges.empty() && ranges.back().begin == position) {
+      continue;
+    }
+    if (false == ranges.empty()) {
+      ranges.back().end = position;
+    }
+    ranges.push_back({position, 0, fit_decoder.GetState()});
+    data_end = position + fit_decoder.GetState().file_bytes_left - FIT_FILE_CRC_SIZE;
+  }
+
+  if (FIT_CONVERT_CONTINUE == fit_status && position < data.size()) {
+    feed(data.size() - position);
+  }
+  if (false == ranges.empty()) {
+    ranges.back().end = data_end;
+  }
+  return fit_status;
+}
+
+// second pass: every range is decoded on its own from the saved state
+FIT_CONVERT_RETURN DecodeRecords(std::string_view data,
+                                 const DecodeRange& range,
+                                 const RecordScatter& record_scatter,
+                                 const DeveloperFieldTable* developer_table,
+                                 std::vector<Record>& records) {
+  FitDecoder fit_decoder;
+  fit_decoder.ContinueFrom(range.state);
+  // the descriptions were collected by the pre-scan, the table is only read here
+  SetupRecordDecoder(fit_decoder, record_scatter, nullptr);
+
+  records.reserve((range.end - range.begin) / kBytesPerRecord);
+  FIT_CONVERT_RETURN fit_status;
+  while (fit_status = fit_decoder.Read(data.data() + range.begin, range.end - range.begin),
+         fit_status == FIT_CONVERT_MESSAGE_AVAILABLE) {
+    Record record;
+    if (DecodeRecord(fit_decoder, record_scatter, developer_table, record)) {
+      records.push_back(record);
+    }
+  }
+
+  // the range has to end at a message boundary
+  if (FIT_CONVERT_CONTINUE != fit_status || FIT_CONVERT_DECODE_RECORD != fit_decoder.GetState().decode_state) {
+    return FIT_CONVERT_ERROR;
+  }
+  return FIT_CONVERT_END_OF_FILE;
+}
+
+// decodes the ranges with the threads and emits records in the file order, only a few ranges past the emitted one
+// are decoded and kept in memory, the records of a range are released as soon as they are emitted
+// returns false without emitting anything when the ranges can't be decoded with one developer table, the file has to
+// be decoded sequentially then
+bool ParseParallel(std::string_view data,
+                   const RecordScatter& record_scatter,
+                   DeveloperFieldTable* developer_table,
+                   const size_t threads_count,
+                   SeekIndex* seek_index,
+                   const RecordCallback& emit_record,
+                   FIT_CONVERT_RETURN& emit_status) {
+  std::vector<DecodeRange> ranges;
+  const size_t ranges_count = std::max<size_t>(data.size() / kDecodeRangeSize, 1);
+  emit_status = PrescanRanges(data, record_scatter, developer_table, ranges_count, ranges);
+  if (FIT_CONVERT_END_OF_FILE != emit_status) {
+    return true;
+  }
+  if (nullptr != developer_table && developer_table->IsRedescribed()) {
+    SPDLOG_INFO("developer fields are described again, decoding sequentially");
+    return false;
+  }
+  if (nullptr != seek_index) {
+    for (const auto& range : ranges) {
+      seek_index->Add(range.begin, range.state);
+    }
+  }
+
+  const size_t window_size = threads_count * kRangesAheadPerThread;
+  std::vector<std::vector<Record>> range_records(ranges.size());
+  std::vector<FIT_CONVERT_RETURN> range_statuses(ranges.size(), FIT_CONVERT_ERROR);
+  std::vector<uint8_t> range_decoded(ranges.size(), 0);
+  std::mutex mutex;
+  std::condition_variable condition;
+  size_t next_range{0};
+  size_t emitted_ranges{0};
+  bool stopped{false};
+  const auto worker = [&]() {
+    for (;;) {
+      size_t index;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&]() {
+          return stopped || next_range >= ranges.size() || next_range < emitted_ranges + window_size;
+        });
+        if (stopped || next_range >= ranges.size()) {
+          return;
         }
+        index = next_range++;
+      }
+      try {
+        range_statuses[index] =
+            DecodeRecords(data, ranges[index], record_scatter, developer_table, range_records[index]);
+      } catch (const std::exception& e) {
+        SPDLOG_ERROR("exception during decoding: {}", e.what());
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        range_decoded[index] = 1;
+      }
+      condition.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t index = 0; index < std::min(threads_count, ranges.size()); ++index) {
+    threads.emplace_back(worker);
+  }
+  const auto stop_threads = [&]() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopped = true;
+    }
+    condition.notify_all();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  };
 
-        if (fit_record_ptr->temperature != FIT_SINT8_INVALID) {
-          // FIT_SINT8 temperature = C
-          ApplyValue(fit_result->result.back(), DataType::kTypeTemperature, fit_record_ptr->temperature);
+  try {
+    for (size_t index = 0; index < ranges.size() && FIT_CONVERT_END_OF_FILE == emit_status; ++index) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&]() { return 0 != range_decoded[index]; });
+      }
+      if (FIT_CONVERT_END_OF_FILE != range_statuses[index]) {
+        emit_status = range_statuses[index];
+        break;
+      }
+      for (const auto& record : range_records[index]) {
+        if (false == emit_record(record)) {
+          // stopped by the callback, the result is still successful
+          stop_threads();
+          return true;
         }
+      }
+      std::vector<Record>().swap(range_records[index]);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++emitted_ranges;
+      }
+      condition.notify_all();
+    }
+  } catch (...) {
+    stop_threads();
+    throw;
+  }
+  stop_threads();
+  return true;
+}
+
+}  // namespace
+
+std::unique_ptr<FitResult> FitParser(std::string input_fit_file,
+                                     const RecordCallback& callback,
+                                     const ParseOptions& options) {
+  if (UseParseCache(input_fit_file, options)) {
+    // records are replayed from the cached columns
+    auto fit_result = FitParser(std::move(input_fit_file), options);
+    if (options.developer_channel_callback) {
+      for (size_t channel = 0; channel < fit_result->developer_channels.size(); ++channel) {
+        options.developer_channel_callback(static_cast<uint32_t>(channel), fit_result->developer_channels[channel]);
+      }
+    }
+    const RecordColumns& records = fit_result->result;
+    for (size_t index = 0; index < records.Size(); ++index) {
+      if (false == callback(records.GetRecord(index))) {
+        break;
+      }
+    }
+    fit_result->result.Clear();
+    return fit_result;
+  }
+
+  auto fit_result = std::make_unique<FitResult>();
+  uint32_t used_data_types{0};  // mask of values DataType values: 0x01 << DataType
+  uint64_t data_source_size{0};
+  size_t records_count{0};
+  int64_t first_timestamp{-1};  // of the file, the time range is relative to it
+  bool stopped_early{false};    // by the callback or after the time range
+  const auto emit_record = [&](const Record& record) {
+    const int64_t timestamp = record.values[static_cast<uint32_t>(DataType::kTypeTimeStamp)];
+    if (first_timestamp < 0) {
+      first_timestamp = timestamp;
+    }
+    if (timestamp - first_timestamp < options.range_from) {
+      return true;
+    }
+    if (timestamp - first_timestamp > options.range_to) {
+      stopped_early = true;
+      return false;
+    }
 
-        if (fit_record_ptr->position_lat != FIT_SINT32_INVALID && fit_record_ptr->position_long != FIT_SINT32_INVALID) {
-          // FIT_SINT32 position_lat = semicircles
-          // FIT_SINT32 position_long = semicircles
-          ApplyValue(fit_result->result.back(), DataType::kTypeLatitude, fit_record_ptr->position_lat);
-          ApplyValue(fit_result->result.back(), DataType::kTypeLongitude, fit_record_ptr->position_long);
+    // first apply to global flags
+    used_data_types |= record.Valid;
+    ++records_count;
+
+    if (false == callback(record)) {
+      stopped_early = true;
+    }
+    return false == stopped_early;
+  };
+
+  try {
+    FIT_CONVERT_RETURN fit_status = FIT_CONVERT_CONTINUE;
+    const RecordScatter record_scatter(options.fields_mask);
+    DeveloperFieldTable developer_fields(options.developer_channel_callback);
+    DeveloperFieldTable* developer_table = options.developer_fields ? &developer_fields : nullptr;
+
+    std::unique_ptr<DataSource> data_source;
+    DataSourceFollow* follow_source{nullptr};  // knows the end of a followed file once its header is complete
+    if (options.follow && kStdinTag != input_fit_file) {
+      auto follow = std::make_unique<DataSourceFollow>(input_fit_file, options.follow_idle_timeout);
+      follow_source = follow.get();
+      data_source = std::move(follow);
+    } else {
+      data_source = CreateDataSource(input_fit_file);
+    }
+    if (DataSource::Type::kStdin != data_source->GetType()) {
+      data_source_size = std::filesystem::file_size(input_fit_file);
+    }
+    const std::string_view contiguous_data = data_source->GetContiguousData();
+
+    // the index is kept only for regular files parsed from the beginning to the end
+    std::unique_ptr<SeekIndex> seek_index;
+    if (options.write_index && false == options.HasRange() && DataSource::Type::kStdin != data_source->GetType()) {
+      seek_index = std::make_unique<SeekIndex>(record_scatter.GetDecodeMask());
+    }
+
+    // an existing index lets the decoding jump close to the start of the time range in a mapped file
+    std::unique_ptr<SeekIndex> range_index;
+    if (options.range_from > 0 && false == contiguous_data.empty() &&
+        DataSource::Type::kStdin != data_source->GetType()) {
+      range_index = std::make_unique<SeekIndex>();
+      const uint32_t decode_mask = record_scatter.GetDecodeMask();
+      if (false == range_index->Load(input_fit_file) || (range_index->GetFieldsMask() & decode_mask) != decode_mask) {
+        range_index.reset();
+      }
+    }
+
+    bool parsed_parallel{false};
+    if (options.decode_threads > 1 && contiguous_data.size() >= kParallelDecodeMinSize && false == options.HasRange()) {
+      parsed_parallel = ParseParallel(contiguous_data, record_scatter, developer_table, options.decode_threads,
+                                      seek_index.get(), emit_record, fit_status);
+      if (false == parsed_parallel) {
+        // the descriptions are collected again in the file order
+        developer_fields.Clear();
+        fit_status = FIT_CONVERT_CONTINUE;
+      }
+    }
+    if (false == parsed_parallel) {
+      FitDecoder fit_decoder;
+      SetupRecordDecoder(fit_decoder, record_scatter, developer_table);
+      fit_decoder.SetOpenEnded(options.follow);
+      Buffer data_buffer(4096);
+      uint64_t data_offset{0};    // offset of the data buffer in the file
+      bool range_seeked{false};   // continued from the index, the decoder does not see the end of the file there
+      bool follow_completed{false};  // the followed file got its data size, the decoder ends there without the crc
+
+      // the last chunk comes together with kEndOfFile, so stop after decoding it instead of spinning at the end
+      DataSource::Status read_status = DataSource::Status::kContinueRead;
+      while ((DataSource::Status::kContinueRead == read_status) && (fit_status == FIT_CONVERT_CONTINUE) &&
+             (false == stopped_early)) {
+        data_offset += data_buffer.GetDataSize();
+        read_status = data_source->ReadData(data_buffer);
+        if (DataSource::Status::kError == read_status) {
+          break;
         }
+        // the decoder read all the data before the buffer, the rest of the file is known now
+        if (nullptr != follow_source && follow_source->GetFinalSize() > 0 && fit_decoder.IsOpenEnded()) {
+          if (follow_source->GetFinalSize() < data_offset + FIT_FILE_CRC_SIZE) {
+            fit_status = FIT_CONVERT_ERROR;
+            break;
+          }
+          fit_decoder.SetFileBytesLeft(static_cast<uint32_t>(follow_source->GetFinalSize() - data_offset));
+          follow_completed = true;
+        }
+        while (fit_status = fit_decoder.Read(data_buffer.GetDataPtr(), data_buffer.GetDataSize()),
+               fit_status == FIT_CONVERT_MESSAGE_AVAILABLE) {
+          Record record;
+          if (false == DecodeRecord(fit_decoder, record_scatter, developer_table, record)) {
+            AddFieldDescription(fit_decoder, developer_table);
+            continue;
+          }
+          if (seek_index && fit_decoder.IsAtMessageBoundary()) {
+            seek_index->Add(data_offset + fit_decoder.GetState().data_offset, fit_decoder.GetState());
+          }
+
+          const bool first_record = first_timestamp < 0;
+          if (false == emit_record(record)) {
+            break;
+          }
+          if (false == first_record || options.range_from <= 0) {
+            continue;
+          }
+
+          // records before the start are skipped by the decoder from now on, without decoding their fields
+          const FIT_DATE_TIME start_time = static_cast<FIT_DATE_TIME>((first_timestamp + options.range_from) / 1000);
+          fit_decoder.SetStartTime(start_time);
+
+          // the entry must precede every record of the start second
+          const SeekIndex::Entry* entry = range_index ? range_index->Find(start_time - 1) : nullptr;
+          if (nullptr == entry || entry->offset <= data_offset + fit_decoder.GetState().data_offset) {
+            continue;
+          }
+          const uint64_t data_end = entry->offset + entry->state.file_bytes_left - FIT_FILE_CRC_SIZE;
+          if (entry->state.file_bytes_left <= FIT_FILE_CRC_SIZE || data_end > contiguous_data.size()) {
+            continue;
+          }
+          fit_decoder.ContinueFrom(entry->state);
+          SetupRecordDecoder(fit_decoder, record_scatter, developer_table);
+          fit_decoder.SetStartTime(start_time);
+          data_buffer.SetExternalData(contiguous_data.data() + entry->offset, data_end - entry->offset);
+          data_offset = entry->offset;
+          range_seeked = true;
+          SPDLOG_INFO("seek index used, decoding continues from offset: {}", entry->offset);
+        }
+      }
 
-        // first apply to global flags
-        used_data_types |= fit_result->result.back().Valid;
+      // the end of the data section was checked when the index was built
+      if (range_seeked && FIT_CONVERT_CONTINUE == fit_status &&
+          FIT_CONVERT_DECODE_RECORD == fit_decoder.GetState().decode_state) {
+        fit_status = FIT_CONVERT_END_OF_FILE;
+      }
+      // a followed file that stopped growing before its end is complete up to the last whole message
+      if (options.follow && false == follow_completed && DataSource::Status::kEndOfFile == read_status &&
+          FIT_CONVERT_CONTINUE == fit_status) {
+        SPDLOG_INFO("followed file did not grow for {} ms, stopped at offset: {}",
+                    options.follow_idle_timeout.count(), data_offset + data_buffer.GetDataSize());
+        fit_status = FIT_CONVERT_END_OF_FILE;
+      }
+      // the crc of the complete file covers the header that was rewritten after the decoding had read it
+      if (follow_completed && FIT_CONVERT_END_OF_FILE == fit_status && false == FitVerify(input_fit_file)) {
+        fit_status = FIT_CONVERT_ERROR;
       }
+      // the size at the opening is stale for a followed file, report what was decoded
+      if (options.follow) {
+        data_source_size = data_offset + (FIT_CONVERT_CONTINUE == fit_status ? data_buffer.GetDataSize()
+                                                                             : fit_decoder.GetState().data_offset);
+      }
+    }
+
+    if (seek_index && FIT_CONVERT_END_OF_FILE == fit_status && false == stopped_early &&
+        seek_index->Save(input_fit_file)) {
+      SPDLOG_INFO("seek index saved: {}, entries: {}", SeekIndex::GetIndexPath(input_fit_file),
+                  seek_index->GetEntries().size());
     }
 
-    if (fit_status == FIT_CONVERT_END_OF_FILE) {
+    if (fit_status == FIT_CONVERT_END_OF_FILE || stopped_early) {
       // success
       fit_result->status = ParseResult::kSuccess;
       fit_result->header_flags = used_data_types;
-
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypeAltitude);
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypeCadence);
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypeDistance);
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypeHeartRate);
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypeLatitude);
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypeLongitude);
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypePower);
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypeSpeed);
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypeTemperature);
-      HeaderItem(fit_result->header, used_data_types, DataType::kTypeTimeStamp);
+      SetHeader(*fit_result);
+      fit_result->developer_channels = developer_fields.GetChannels();
 
     } else if (fit_status == FIT_CONVERT_ERROR) {
       SPDLOG_ERROR("error decoding file");
@@ -342,6 +1145,125 @@ std::unique_ptr<FitResult> FitParser(std::string input_fit_file) {
     // file errors usually
     SPDLOG_ERROR("exception during processing: {}", e.what());
   }
-  SPDLOG_INFO("fit records processed: {}, source size: {}", fit_result->result.size(), data_source_size);
+  SPDLOG_INFO("fit records processed: {}, source size: {}", records_count, data_source_size);
+  return fit_result;
+}
+
+std::unique_ptr<FitResult> FitParser(std::string input_fit_file, const ParseOptions& options) {
+  std::unique_ptr<ParseCache> parse_cache;
+  if (UseParseCache(input_fit_file, options)) {
+    const uint32_t cache_mask = options.fields_mask | (options.developer_fields ? kParseCacheDeveloperFields : 0);
+    parse_cache = ParseCache::Create(options.cache_dir, input_fit_file, cache_mask);
+  }
+  if (parse_cache) {
+    auto fit_result = std::make_unique<FitResult>();
+    if (parse_cache->Load(*fit_result)) {
+      fit_result->status = ParseResult::kSuccess;
+      SetHeader(*fit_result);
+      SPDLOG_INFO("parse cache used: {}, records: {}", parse_cache->GetCachePath(), fit_result->result.Size());
+      return fit_result;
+    }
+  }
+
+  RecordColumns records;
+  if (kStdinTag != input_fit_file) {
+    std::error_code size_error;
+    const uint64_t data_source_size = std::filesystem::file_size(input_fit_file, size_error);
+    records.Reserve(size_error ? 0 : data_source_size / kBytesPerRecord);
+  }
+
+  ParseOptions parse_options(options);
+  parse_options.cache_dir.clear();
+  // the channels are in the result
+  parse_options.developer_channel_callback = nullptr;
+  auto fit_result = FitParser(std::move(input_fit_file), [&records](const Record& record) {
+    records.Append(record);
+    return true;
+  }, parse_options);
+  fit_result->result = std::move(records);
+
+  if (parse_cache && ParseResult::kSuccess == fit_result->status && parse_cache->Save(*fit_result)) {
+    SPDLOG_INFO("parse cache saved: {}", parse_cache->GetCachePath());
+  }
   return fit_result;
 }
+
+bool FitVerify(std::string input_fit_file) {
+  try {
+    Buffer data_buffer(4096);
+    std::unique_ptr<DataSource> data_source = CreateDataSource(input_fit_file);
+
+    FIT_UINT8 header[FIT_FILE_HDR_SIZE]{};
+    size_t header_size = 0;   // known after the first byte
+    uint64_t file_size = 0;   // header + data + crc, known after the header
+    uint64_t processed = 0;
+    FIT_UINT16 crc = 0;
+
+    DataSource::Status read_status = DataSource::Status::kContinueRead;
+    while (DataSource::Status::kContinueRead == read_status && (0 == file_size || processed < file_size)) {
+      read_status = data_source->ReadData(data_buffer);
+      if (DataSource::Status::kError == read_status) {
+        return false;
+      }
+
+      const FIT_UINT8* data_ptr = reinterpret_cast<const FIT_UINT8*>(data_buffer.GetDataPtr());
+      size_t data_size = data_buffer.GetDataSize();
+
+      // the header is collected byte by byte, it is at most 14 bytes
+      while (0 == file_size && data_size > 0) {
+        if (0 == processed) {
+          header_size = *data_ptr;
+          if (header_size < FIT_FILE_HDR_SIZE - FIT_FILE_CRC_SIZE) {
+            SPDLOG_ERROR("file is not FIT file");
+            return false;
+          }
+        }
+        if (processed < FIT_FILE_HDR_SIZE) {
+          header[processed] = *data_ptr;
+        }
+        crc = FitCRC_Get16(crc, *data_ptr);
+        ++data_ptr;
+        --data_size;
+        ++processed;
+
+        if (processed == header_size) {
+          if (memcmp(&header[8], ".FIT", 4) != 0) {
+            SPDLOG_ERROR("file is not FIT file");
+            return false;
+          }
+          // header crc is optional, zero means it was not calculated
+          const FIT_UINT16 header_crc = static_cast<FIT_UINT16>(header[12] | (header[13] << 8));
+          if (header_size >= FIT_FILE_HDR_SIZE && header_crc != 0 &&
+              FitCRC_Calc16(header, FIT_FILE_HDR_SIZE - FIT_FILE_CRC_SIZE) != header_crc) {
+            SPDLOG_ERROR("file header crc mismatch");
+            return false;
+          }
+          const uint32_t data_size_field = static_cast<uint32_t>(header[4]) | (static_cast<uint32_t>(header[5]) << 8) |
+                                           (static_cast<uint32_t>(header[6]) << 16) |
+                                           (static_cast<uint32_t>(header[7]) << 24);
+          file_size = header_size + static_cast<uint64_t>(data_size_field) + FIT_FILE_CRC_SIZE;
+        }
+      }
+
+      if (file_size > 0 && data_size > 0) {
+        const size_t crc_size = static_cast<size_t>(std::min<uint64_t>(data_size, file_size - processed));
+        crc = FitCRC_Update16(crc, data_ptr, static_cast<FIT_UINT32>(crc_size));
+        processed += crc_size;
+      }
+    }
+
+    if (0 == file_size || processed < file_size) {
+      SPDLOG_ERROR("unexpected end of file");
+      return false;
+    }
+    // crc over the data followed by its own crc is zero
+    if (crc != 0) {
+      SPDLOG_ERROR("file crc mismatch");
+      return false;
+    }
+    return true;
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("exception during verification: {}", e.what());
+  }
+  return false;
+}
@@ -19,6 +19,12 @@
 
 */
 
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <string>
 #include <vector>
 #include <memory>
@@ -42,10 +48,17 @@ enum class DataType : uint32_t {
 
 inline constexpr uint32_t kDataTypeFirst = static_cast<uint32_t>(DataType::kTypeFirst);
 inline constexpr uint32_t kDataTypeMax = static_cast<uint32_t>(DataType::kTypeMax);
+inline constexpr uint32_t kDataTypeAllMask = (0x01 << kDataTypeMax) - 1;
+
+// developer fields are decoded into extra channels, see FitResult::developer_channels
+inline constexpr uint32_t kDeveloperChannelsMax = 8;
 
 struct Record {
   int64_t values[static_cast<uint32_t>(DataType::kTypeMax)]{};
   uint32_t Valid{0};  // mask of values DataType values: 0x01 << DataType
+  // raw values of developer channels, physical value = value / scale - offset of the channel
+  int64_t developer_values[kDeveloperChannelsMax]{};
+  uint32_t developer_valid{0};  // mask of developer channels: 0x01 << channel
 };
 
 constexpr Record operator-(const Record left_value, const Record right_value) {
@@ -54,6 +67,10 @@ constexpr Record operator-(const Record left_value, const Record right_value) {
   for (uint32_t index = kDataTypeFirst; index < kDataTypeMax; ++index) {
     diff_record.values[index] = left_value.values[index] - right_value.values[index];
   }
+  diff_record.developer_valid = left_value.developer_valid & right_value.developer_valid;
+  for (uint32_t index = 0; index < kDeveloperChannelsMax; ++index) {
+    diff_record.developer_values[index] = left_value.developer_values[index] - right_value.developer_values[index];
+  }
   return diff_record;
 }
 
@@ -63,6 +80,10 @@ constexpr Record operator+(const Record left_value, const Record right_value) {
   for (uint32_t index = kDataTypeFirst; index < kDataTypeMax; ++index) {
     summ_record.values[index] = left_value.values[index] + right_value.values[index];
   }
+  summ_record.developer_valid = left_value.developer_valid & right_value.developer_valid;
+  for (uint32_t index = 0; index < kDeveloperChannelsMax; ++index) {
+    summ_record.developer_values[index] = left_value.developer_values[index] + right_value.developer_values[index];
+  }
   return summ_record;
 }
 
@@ -72,9 +93,122 @@ constexpr Record operator/(const Record left_value, const int64_t divider) {
   for (uint32_t index = kDataTypeFirst; index < kDataTypeMax; ++index) {
     divided_record.values[index] = left_value.values[index] / divider;
   }
+  divided_record.developer_valid = left_value.developer_valid;
+  for (uint32_t index = 0; index < kDeveloperChannelsMax; ++index) {
+    divided_record.developer_values[index] = left_value.developer_values[index] / divider;
+  }
   return divided_record;
 }
 
+// values of one channel: own storage while the records are appended, or a view into a mapped parse cache file
+template <typename T>
+class Column final {
+ public:
+  using ValueType = T;
+
+  void Reserve(const size_t size) { values_.reserve(size); }
+  void Clear() {
+    values_.clear();
+    mapped_ = nullptr;
+    mapped_size_ = 0;
+  }
+  void PushBack(const T value) { values_.push_back(value); }
+  T& Back() { return values_.back(); }
+
+  // the values are not copied, the memory is kept alive by the owner of the column
+  void Map(const T* data, const size_t size) {
+    values_.clear();
+    mapped_ = data;
+    mapped_size_ = size;
+  }
+
+  const T* Data() const { return nullptr != mapped_ ? mapped_ : values_.data(); }
+  size_t Size() const { return nullptr != mapped_ ? mapped_size_ : values_.size(); }
+  T operator[](const size_t index) const { return Data()[index]; }
+
+ private:
+  std::vector<T> values_;
+  const T* mapped_{nullptr};
+  size_t mapped_size_{0};
+};
+
+// struct-of-arrays storage for parsed records: every channel is a dense array of the narrowest type that holds its FIT
+// field plus a presence bitmap, all channels are indexed by the position in the shared timestamp column
+class RecordColumns final {
+ public:
+  void Reserve(const size_t records_count);
+  void Clear();
+  void Append(const Record& record);
+
+  size_t Size() const { return size_; }
+  bool Empty() const { return 0 == size_; }
+
+  bool IsValid(const size_t index, const DataType type) const {
+    return (presence_[static_cast<uint32_t>(type)][index / 64] & (uint64_t{1} << (index % 64))) != 0;
+  }
+  int64_t GetValue(const size_t index, const DataType type) const;
+  Record GetRecord(const size_t index) const;
+
+  // developer channels get their columns when the first value of the channel is appended
+  size_t GetDeveloperChannelsCount() const { return developer_values_.size(); }
+  bool IsDeveloperValid(const size_t index, const uint32_t channel) const {
+    return channel < developer_values_.size() &&
+           (developer_presence_[channel][index / 64] & (uint64_t{1} << (index % 64))) != 0;
+  }
+  int64_t GetDeveloperValue(const size_t index, const uint32_t channel) const {
+    return developer_values_[channel][index];
+  }
+
+  // timestamps are whole seconds since UTC 00:00 Dec 31 1989, as they are stored in .fit file
+  const Column<uint32_t>& GetTimestamps() const { return timestamps_; }
+  const Column<uint64_t>& GetPresence(const DataType type) const { return presence_[static_cast<uint32_t>(type)]; }
+
+ private:
+  friend class ParseCache;
+
+  // every column in the order of the parse cache file, for const and mutable columns
+  template <typename Columns, typename Visitor>
+  static void VisitColumns(Columns& columns, Visitor&& visitor) {
+    for (auto& presence : columns.presence_) {
+      visitor(presence);
+    }
+    visitor(columns.timestamps_);
+    visitor(columns.speed_);
+    visitor(columns.distance_);
+    visitor(columns.heart_rate_);
+    visitor(columns.altitude_);
+    visitor(columns.power_);
+    visitor(columns.cadence_);
+    visitor(columns.temperature_);
+    visitor(columns.latitude_);
+    visitor(columns.longitude_);
+    for (size_t channel = 0; channel < columns.developer_values_.size(); ++channel) {
+      visitor(columns.developer_presence_[channel]);
+      visitor(columns.developer_values_[channel]);
+    }
+  }
+
+  void AddDeveloperChannels(const size_t channels_count);
+
+  size_t size_{0};
+  Column<uint64_t> presence_[kDataTypeMax];
+
+  Column<uint32_t> timestamps_;
+  Column<uint32_t> speed_;
+  Column<uint32_t> distance_;
+  Column<uint8_t> heart_rate_;
+  Column<uint32_t> altitude_;
+  Column<uint16_t> power_;
+  Column<uint8_t> cadence_;
+  Column<int8_t> temperature_;
+  Column<int32_t> latitude_;
+  Column<int32_t> longitude_;
+  std::vector<Column<uint64_t>> developer_presence_;
+  std::vector<Column<int64_t>> developer_values_;
+  // mapped parse cache file the columns point to
+  std::shared_ptr<const void> storage_;
+};
+
 struct DataTagUnit {
   DataTagUnit() = default;
   DataTagUnit(std::string_view tag, std::string_view units) : data_tag(std::move(tag)), data_units(std::move(units)) {}
@@ -90,21 +224,80 @@ enum class ParseResult {
   kError,
 };
 
+// developer field decoded into a channel, described by its field_description message
+struct DeveloperChannel {
+  std::string name;
+  std::string units;
+  // physical value = raw value / scale - offset, floating point fields are stored multiplied by kFloatScale
+  double scale{1.0};
+  double offset{0.0};
+
+  static constexpr double kFloatScale = 1000.0;
+};
+
 struct FitResult {
   // parsing status
   ParseResult status{ParseResult::kError};
 
   // parsed data from file
-  std::vector<Record> result;
+  RecordColumns result;
 
   // header for all available types of data in this file
   std::vector<DataTagUnit> header;
   // header in bitmask format
   uint32_t header_flags{0};
+  // developer channels of the record message described in the file, in the order of Record::developer_values
+  std::vector<DeveloperChannel> developer_channels;
 };
 
 std::string_view DataTypeToName(const DataType type);
 std::string_view DataTypeToUnit(const DataType type);
 uint32_t DataTypeToMask(const DataType type);
+// reverse of DataTypeToName, returns false for unknown names
+bool DataTypeFromName(std::string_view name, DataType& type);
+
+// called for every decoded record in file order, return false to stop decoding (the result is still successful)
+using RecordCallback = std::function<bool(const Record& record)>;
+// called when a developer channel is described, before the records with its values are passed to the RecordCallback
+using DeveloperChannelCallback = std::function<void(const uint32_t channel, const DeveloperChannel& developer_channel)>;
+
+inline constexpr int64_t kRangeEndless = std::numeric_limits<int64_t>::max();
+
+struct ParseOptions {
+  // data types to decode (0x01 << DataType), the timestamp is always decoded
+  uint32_t fields_mask{kDataTypeAllMask};
+  // threads for one large mapped file: definitions are pre-scanned and ranges of the file are decoded in parallel
+  size_t decode_threads{1};
+  // write the sidecar seek index (input.fit.idx) as a by-product of a complete parsing of a file
+  bool write_index{false};
+  // time range in milliseconds from the first record of the file, records outside of it are not emitted
+  // the start is reached with the seek index when there is one, decoding stops after the end of the range
+  int64_t range_from{0};
+  int64_t range_to{kRangeEndless};
+
+  // wait for data appended to a file that is still being written, until the end of the file or until it did not
+  // grow for the idle timeout (zero waits forever), records are passed to the callback as they are appended
+  bool follow{false};
+  std::chrono::milliseconds follow_idle_timeout{0};
+
+  // decode developer fields of record messages into developer channels
+  bool developer_fields{true};
+  // optional, for the consumers of the records that need the channel descriptions while the records are streamed
+  DeveloperChannelCallback developer_channel_callback;
+  // directory of the parse cache: results are stored by the content hash of the input and reused for the same content
+  // empty to disable, used for complete parsing of regular files only
+  std::string cache_dir;
+
+  bool HasRange() const { return range_from > 0 || range_to != kRangeEndless; }
+};
+
+// collects all records of the file into FitResult::result
+std::unique_ptr<FitResult> FitParser(std::string input, const ParseOptions& options = {});
+
+// streams records to the callback in file order, FitResult::result stays empty
+std::unique_ptr<FitResult> FitParser(std::string input,
+                                     const RecordCallback& callback,
+                                     const ParseOptions& options = {});
 
-std::unique_ptr<FitResult> FitParser(std::string input);
+// checks file header and file CRCs without decoding messages
+bool FitVerify(std::string input);
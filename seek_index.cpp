@@ -0,0 +1,228 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#include "seek_index.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "parse_cache.h"
+
+namespace {
+
+constexpr char kSeekIndexMagic[8] = {'F', 'I', 'T', '2', 'I', 'D', 'X', '\0'};
+constexpr uint32_t kSeekIndexVersion = 2;
+// the offset and the decoder state of an entry as they are stored
+constexpr size_t kStoredEntrySize = sizeof(uint64_t) + sizeof(FIT_CONVERT_STATE);
+
+struct SeekIndexHeader {
+  char magic[sizeof(kSeekIndexMagic)]{};
+  uint32_t version{0};
+  uint32_t state_size{0};  // layout of FIT_CONVERT_STATE depends on the build
+  uint64_t source_size{0};
+  int64_t source_time{0};
+  uint32_t fields_mask{0};
+  uint32_t entries_count{0};
+  uint64_t entries_hash{0};  // of the stored entries, see ParseCache::ContentHash
+};
+
+// size and modification time tell if the index belongs to the current content of the source file
+bool GetSourceInfo(const std::string& fit_file, SeekIndexHeader& header) {
+  std::error_code file_error;
+  header.source_size = std::filesystem::file_size(fit_file, file_error);
+  if (file_error) {
+    return false;
+  }
+  const auto write_time = std::filesystem::last_write_time(fit_file, file_error);
+  if (file_error) {
+    return false;
+  }
+  header.source_time = static_cast<int64_t>(write_time.time_since_epoch().count());
+  return true;
+}
+
+// the state is used to continue decoding as is, so everything that indexes the decoder tables has to be in bounds
+bool IsStateValid(const FIT_CONVERT_STATE& state, const uint64_t offset, const uint64_t source_size) {
+  if (FIT_CONVERT_DECODE_RECORD != state.decode_state || state.mesg_index >= FIT_LOCAL_MESGS ||
+      state.num_mesg_filter > FIT_MESG_FILTER_MAX || state.file_bytes_left <= FIT_FILE_CRC_SIZE ||
+      offset + state.file_bytes_left > source_size) {
+    return false;
+  }
+  for (uint32_t index = 0; index < FIT_LOCAL_MESGS; ++index) {
+    const FIT_MESG_CONVERT& mesg_convert = state.convert_table[index];
+    if (mesg_convert.num_fields > std::size(mesg_convert.fields) ||
+        state.num_dev_field_defs[index] > FIT_DEV_FIELDS_MAX) {
+      return false;
+    }
+    for (uint32_t field = 0; field < mesg_convert.num_fields; ++field) {
+      const FIT_FIELD_CONVERT& field_convert = mesg_convert.fields[field];
+      if (field_convert.offset_local + field_convert.size > FIT_MESG_SIZE ||
+          field_convert.offset_in + field_convert.size > state.mesg_sizes[index]) {
+        return false;
+      }
+    }
+    size_t dev_data_size = 0;
+    for (uint32_t field = 0; field < state.num_dev_field_defs[index]; ++field) {
+      dev_data_size += state.dev_field_defs[index][field].size;
+    }
+    if (dev_data_size > state.dev_data_sizes[index] ||
+        state.mesg_sizes[index] > static_cast<size_t>(FIT_MAX_FIELD_SIZE) * FIT_MAX_FIELD_SIZE) {
+      return false;
+    }
+#if defined(FIT_CONVERT_TIME_RECORD)
+    if ((FIT_UINT16_INVALID != state.timestamp_offsets[index] &&
+         state.timestamp_offsets[index] + sizeof(FIT_DATE_TIME) > FIT_MESG_SIZE) ||
+        (FIT_UINT8_INVALID != state.timestamp_fields[index] &&
+         state.timestamp_fields[index] >= mesg_convert.num_fields)) {
+      return false;
+    }
+#endif
+  }
+  return true;
+}
+
+}  // namespace
+
+void SeekIndex::Add(const uint64_t offset, const FIT_CONVERT_STATE& state) {
+  if (false == entries_.empty() &&
+      (offset < entries_.back().offset + kInterval || state.timestamp < entries_.back().state.timestamp)) {
+    return;
+  }
+  entries_.push_back({offset, state});
+  // the message buffer is not needed to continue decoding, keep the file reproducible
+  std::memset(&entries_.back().state.u, 0, sizeof(entries_.back().state.u));
+}
+
+bool SeekIndex::Load(const std::string& fit_file) {
+  entries_.clear();
+  try {
+    std::ifstream input_stream(GetIndexPath(fit_file), std::ios::in | std::ios::binary);
+    if (false == input_stream.is_open()) {
+      return false;
+    }
+
+    SeekIndexHeader header;
+    SeekIndexHeader source_header;
+    input_stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (false == input_stream.good() || false == GetSourceInfo(fit_file, source_header) ||
+        0 != std::memcmp(header.magic, kSeekIndexMagic, sizeof(kSeekIndexMagic)) ||
+        header.version != kSeekIndexVersion || header.state_size != sizeof(FIT_CONVERT_STATE) ||
+        header.source_size != source_header.source_size || header.source_time != source_header.source_time) {
+      SPDLOG_INFO("seek index is outdated: {}", GetIndexPath(fit_file));
+      return false;
+    }
+
+    // the whole index is rejected if it is truncated, has extra data or any stored entry was changed
+    std::error_code size_error;
+    const uint64_t index_size = std::filesystem::file_size(GetIndexPath(fit_file), size_error);
+    if (size_error || index_size != sizeof(header) + static_cast<uint64_t>(header.entries_count) * kStoredEntrySize) {
+      SPDLOG_ERROR("seek index is broken: {}", GetIndexPath(fit_file));
+      return false;
+    }
+    std::string stored_entries(static_cast<size_t>(header.entries_count) * kStoredEntrySize, '\0');
+    input_stream.read(stored_entries.data(), static_cast<std::streamsize>(stored_entries.size()));
+    if (false == input_stream.good() || ParseCache::ContentHash(stored_entries) != header.entries_hash) {
+      SPDLOG_ERROR("seek index is broken: {}", GetIndexPath(fit_file));
+      return false;
+    }
+
+    entries_.resize(header.entries_count);
+    for (size_t index = 0; index < entries_.size(); ++index) {
+      Entry& entry = entries_[index];
+      const char* stored_entry = stored_entries.data() + index * kStoredEntrySize;
+      std::memcpy(&entry.offset, stored_entry, sizeof(entry.offset));
+      std::memcpy(&entry.state, stored_entry + sizeof(entry.offset), sizeof(entry.state));
+      const bool ordered = 0 == index || (entry.offset > entries_[index - 1].offset &&
+                                          entry.state.timestamp >= entries_[index - 1].state.timestamp);
+      if (entry.offset >= header.source_size || false == ordered ||
+          false == IsStateValid(entry.state, entry.offset, header.source_size)) {
+        SPDLOG_ERROR("seek index is broken: {}", GetIndexPath(fit_file));
+        entries_.clear();
+        return false;
+      }
+      // pointers to the SDK message definitions are valid only in the process that saved them
+      for (uint32_t local_mesg = 0; local_mesg < FIT_LOCAL_MESGS; ++local_mesg) {
+        if (FIT_NULL != entry.state.mesg_defs[local_mesg]) {
+          entry.state.mesg_defs[local_mesg] = Fit_GetMesgDef(entry.state.convert_table[local_mesg].global_mesg_num);
+        }
+      }
+      entry.state.mesg_def = nullptr;
+    }
+    fields_mask_ = header.fields_mask;
+    return true;
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("seek index reading error: {}", e.what());
+  }
+  entries_.clear();
+  return false;
+}
+
+bool SeekIndex::Save(const std::string& fit_file) const {
+  const std::string index_file(GetIndexPath(fit_file));
+  try {
+    SeekIndexHeader header;
+    if (false == GetSourceInfo(fit_file, header)) {
+      return false;
+    }
+    std::memcpy(header.magic, kSeekIndexMagic, sizeof(kSeekIndexMagic));
+    header.version = kSeekIndexVersion;
+    header.state_size = sizeof(FIT_CONVERT_STATE);
+    header.fields_mask = fields_mask_;
+    header.entries_count = static_cast<uint32_t>(entries_.size());
+
+    std::string stored_entries;
+    stored_entries.reserve(entries_.size() * kStoredEntrySize);
+    for (const auto& entry : entries_) {
+      stored_entries.append(reinterpret_cast<const char*>(&entry.offset), sizeof(entry.offset));
+      stored_entries.append(reinterpret_cast<const char*>(&entry.state), sizeof(entry.state));
+    }
+    header.entries_hash = ParseCache::ContentHash(stored_entries);
+
+    std::ofstream output_stream(index_file, std::ios::out | std::ios::trunc | std::ios::binary);
+    output_stream.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+    output_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output_stream.write(stored_entries.data(), static_cast<std::streamsize>(stored_entries.size()));
+    output_stream.close();
+    return true;
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("seek index writing error: {}, check: {}", e.what(), index_file);
+  }
+  return false;
+}
+
+const SeekIndex::Entry* SeekIndex::Find(const uint32_t timestamp) const {
+  const auto entry = std::upper_bound(
+      entries_.begin(), entries_.end(), timestamp, [](const uint32_t value, const Entry& item) {
+        return value < item.GetTimestamp();
+      });
+  if (entry == entries_.begin()) {
+    return nullptr;
+  }
+  return &*std::prev(entry);
+}
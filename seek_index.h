@@ -0,0 +1,75 @@
+/*
+
+ MIT License
+
+ Copyright (c) 2022 pavel.sokolov@gmail.com / CEZEO software Ltd. All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+ persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "fitsdk/fit_convert.h"
+
+inline constexpr std::string_view kSeekIndexExtension(".idx");
+
+// Sidecar index of a .fit file (input.fit.idx): byte offsets of message boundaries in the data section together
+// with the decoder state there, so decoding can continue from the middle of the file.
+// The decoder state is stored as is (definition pointers are resolved again on loading), so the index is a local cache
+// valid only for the same build and the same source file.
+class SeekIndex final {
+ public:
+  struct Entry {
+    uint64_t offset{0};
+    FIT_CONVERT_STATE state{};
+
+    // timestamp of the last message with a timestamp before the offset, seconds since UTC 00:00 Dec 31 1989
+    uint32_t GetTimestamp() const { return state.timestamp; }
+  };
+
+  // entries are added not closer than this, every entry keeps a whole decoder state
+  static constexpr uint64_t kInterval = 1024 * 1024;
+
+  explicit SeekIndex(const uint32_t fields_mask = 0) : fields_mask_(fields_mask) {}
+
+  static std::string GetIndexPath(const std::string& fit_file) { return fit_file + std::string(kSeekIndexExtension); }
+
+  // offsets have to grow, entries closer than kInterval to the previous one are dropped, as well as entries with a
+  // timestamp before the previous one (clock corrections), Find relies on the timestamps being ordered
+  void Add(const uint64_t offset, const FIT_CONVERT_STATE& state);
+
+  // returns false if the index file is missing, broken or was built for another version of the source file
+  bool Load(const std::string& fit_file);
+  bool Save(const std::string& fit_file) const;
+
+  // the last entry at or before the timestamp, nullptr if decoding has to start from the beginning
+  const Entry* Find(const uint32_t timestamp) const;
+
+  // data types the record definitions in the states were decoded with, see ParseOptions::fields_mask
+  uint32_t GetFieldsMask() const { return fields_mask_; }
+  const std::vector<Entry>& GetEntries() const { return entries_; }
+
+ private:
+  uint32_t fields_mask_{0};
+  std::vector<Entry> entries_;
+};